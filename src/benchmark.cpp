@@ -2,19 +2,51 @@
 // benchmark.cpp
 //
 // Main program that performs a timed benchmark of dictionary operations.
-//
-// Students: you do not need to modify this file.
+// By default it times one structure phase by phase (inserts, hits and
+// misses, in ns/op), optionally with warmup and repetitions, hardware
+// event counts, or sampled latency histograms, then compares single and
+// batched lookups and times erase churn. Other modes time load-factor
+// and reader scaling, bulk and parallel builds, small maps, concurrent
+// and snapshot tables under a multi-threaded read/write mix, and YCSB
+// workloads over skewed keys; --sweep writes the structure-by-size CSV.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "concurrent.hpp"
 #include "hashes.hpp"
+#include "workload.hpp"
 
 using namespace std;
 using namespace hashes;
@@ -23,173 +55,2377 @@ const uint32_t SEED{0};
 
 void print_usage() {
   cout << "usage:" << endl
-       << "    benchmark <STRUCTURE> <N>" << endl
+       << "    benchmark <STRUCTURE> <N> [--load-factor L] [--batch-insert] [--counters]" << endl
+       << "        [--warmup W] [--repetitions R] [--keys ORDER]" << endl
+       << "        [--load-sweep | --readers | --latency K [--latency-csv FILE]" << endl
+       << "         | --ycsb W [--distribution D] [--operations M] [--latency K [--latency-csv FILE]]]" << endl
+       << "    benchmark <chain|lp> <N> --parallel-build" << endl
+       << "    benchmark <chain|lp|cuckoo|sorted|eytzinger> <N> --bulk-build" << endl
+       << "    benchmark small_map <N> --small-maps" << endl
+       << "    benchmark <CONCURRENT STRUCTURE> <N> --threads T [--read-ratio R] [--duration S]" << endl
+       << "    benchmark --sweep [--structures S,...] [--sizes N,...] [--load-factors L,...]" << endl
+       << "        [--timeout S] [--output FILE] [--warmup W] [--repetitions R] [--keys ORDER]" << endl
        << endl
        << "where" << endl
-       << "    <STRUCTURE> is one of: naive chain lp cuckoo" << endl
+       << "    <STRUCTURE> is one of: naive chain lp lp_quadratic lp_double robin_hood cuckoo swiss lp_simd" << endl
+       << "        sorted eytzinger small_map" << endl
+       << "        or a concurrent structure: striped_chain lockfree_lp concurrent_cuckoo sharded_chain" << endl
+       << "        (concurrent structures run the multi-threaded mixed workload)" << endl
+       << "        or a snapshot structure: snapshot_lp snapshot_chain" << endl
+       << "        (snapshot structures time lookups while tables are republished)" << endl
        << "    <N>: input size (positive integer)" << endl
+       << "    --load-sweep: (lp_simd only) compare scalar and SIMD lookups in a" << endl
+       << "        table of about N slots at load factors from 0.5 to 0.95" << endl
+       << "    --readers: after inserting, time read-only lookups on the shared" << endl
+       << "        const table with 1, 2, 4, ... threads up to the number of cores" << endl
+       << "        (concurrent structures: while one writer thread sets and erases)" << endl
+       << "    --batch-insert: insert each half with one insert_batch call instead" << endl
+       << "        of one set call per key" << endl
+       << "    --parallel-build: (chain and lp only) time building a table of N keys" << endl
+       << "        with parallel_build_from on 1, 2, 4, ... threads up to the number of cores," << endl
+       << "        and the time per hit and per miss on each built table" << endl
+       << "    --bulk-build: (chain, lp, cuckoo, sorted and eytzinger only) build a" << endl
+       << "        table of N keys, a tenth of them given twice, with build_from, and" << endl
+       << "        one with each key's last value through set, check that both hold" << endl
+       << "        the same values, and time each and the hits and misses on each" << endl
+       << "        (the set table is sized by --load-factor)" << endl
+       << "    --small-maps: build, query and destroy N maps of each size from 4 to" << endl
+       << "        64 with small_map and a few hash tables, and compare time per map" << endl
+       << "    --threads: (concurrent structures) run T worker threads, pinned to" << endl
+       << "        cores, on one shared table of N/2 keys for S seconds (default 1)," << endl
+       << "        each op a search with probability R (default 0.9) and otherwise" << endl
+       << "        a set or an erase, and report throughput and contention" << endl
+       << "    --sweep: run the insert and search phases for every structure and" << endl
+       << "        size (default: naive chain lp cuckoo, 100 to 100000), each in its" << endl
+       << "        own process, and write the elapsed seconds as a CSV with one row" << endl
+       << "        per structure and one column per size (default file:" << endl
+       << "        \"Dictionary Data Structure times.csv\"). A cell that fails or" << endl
+       << "        runs longer than the timeout (default 10 seconds) is written as n/a." << endl
+       << "        With --load-factors, each structure is run with --load-factor L" << endl
+       << "        for each L, in rows named STRUCTURE@L" << endl
+       << "    --warmup W --repetitions R: run the insert and search phases W times" << endl
+       << "        untimed, then R times timed, each on a fresh table from the same" << endl
+       << "        input, and report the min, median, mean, standard deviation and" << endl
+       << "        95% confidence interval of each phase (with --sweep, each cell" << endl
+       << "        records the median)" << endl
+       << "    --latency K: after the phases, fill a fresh table and look up every" << endl
+       << "        present and absent key, timing about 1 in K of the set and find" << endl
+       << "        calls, and report p50, p90, p99, p99.9 and max latency of each;" << endl
+       << "        with --ycsb, time about 1 in K of the workload's operations instead" << endl
+       << "    --latency-csv FILE: also write the latency histograms to FILE" << endl
+       << "    --counters: (Linux) also count cycles, instructions, L1D, LLC and dTLB" << endl
+       << "        misses and branch mispredictions in each phase with perf_event_open," << endl
+       << "        and report them per operation; events that cannot be counted are" << endl
+       << "        reported as n/a" << endl
+       << "    --keys ORDER: the order of the 1.5 N distinct keys, one of" << endl
+       << "        uniform: a random permutation of [0, 1.5 N) (the default)" << endl
+       << "        sequential: 0, 1, 2, ..." << endl
+       << "        strided[:S]: 0, S, 2S, ... (default S = 64)" << endl
+       << "        adversarial: keys whose home slots all lie in the first 1/64 of" << endl
+       << "        the table (single-threaded structures other than cuckoo)" << endl
+       << "    --ycsb W: after the phases, run M (default N) operations of YCSB core" << endl
+       << "        workload W on a fresh table of the N keys, sized for them and the" << endl
+       << "        workload's inserts at load factor 0.7 (or L): A (50% read, 50%" << endl
+       << "        update), B (95% read, 5% update), C (read only), D (95% read, 5%" << endl
+       << "        insert, newest first), E (95% scans of up to 100 keys, 5% insert)" << endl
+       << "        or F (50% read, 50% read-modify-write), and report the throughput" << endl
+       << "    --distribution D: how --ycsb picks records instead of the workload's" << endl
+       << "        default, one of uniform, zipf[:THETA] (default 0.99)," << endl
+       << "        hotspot[:H] (a fraction H of records, default 0.2, get 1 - H of" << endl
+       << "        the operations) or latest[:THETA]" << endl
+       << "    --load-factor L: size the table for N keys at load factor L: lp," << endl
+       << "        lp_quadratic, lp_double and robin_hood get N / L slots, and other" << endl
+       << "        structures a capacity of N / L (default 1)" << endl
+       << "    --sweep-cell: run only the insert and search phases (used by --sweep)" << endl
        << endl;
 }
 
-int main(int argc, char* argv[]) {
+// Create the single-threaded dictionary named structure, sized for n keys
+// at the given load factor, or return null if structure is not the name of
+// one. lp_dict and robin_hood_dict take the load factor themselves; the
+// other structures get a capacity of n / load. The hash functions draw
+// their coefficients from rand(), which is first reset to the C library's
+// initial seed, so every table made for a structure and size hashes keys
+// alike, and --keys adversarial keys collide in each of them.
+unique_ptr<abstract_dict<uint32_t>> make_dict(const string& structure, size_t n, double load = 1) {
+  srand(1);
+  unique_ptr<abstract_dict<uint32_t>> dict;
+  size_t capacity = max<size_t>(1, size_t(n / load + 0.5));
+  if (structure == "naive") {
+    dict.reset(new naive_dict<uint32_t>(capacity));
+  } else if (structure == "chain") {
+    dict.reset(new chain_dict<uint32_t>(capacity));
+  } else if (structure == "lp") {
+    dict.reset(new lp_dict<uint32_t>(n, load));
+  } else if (structure == "lp_quadratic") {
+    dict.reset(new lp_dict<uint32_t, quadratic_probe>(n, load));
+  } else if (structure == "lp_double") {
+    dict.reset(new lp_dict<uint32_t, double_hash_probe>(n, load));
+  } else if (structure == "robin_hood") {
+    dict.reset(new robin_hood_dict<uint32_t>(n, load));
+  } else if (structure == "cuckoo") {
+    dict.reset(new cuckoo_dict<uint32_t>(capacity));
+  } else if (structure == "swiss") {
+    dict.reset(new swiss_dict<uint32_t>(capacity));
+  } else if (structure == "lp_simd") {
+    dict.reset(new flat_lp_dict<uint32_t>(capacity));
+  } else if (structure == "sorted") {
+    dict.reset(new sorted_dict<uint32_t>(capacity));
+  } else if (structure == "eytzinger") {
+    dict.reset(new sorted_dict<uint32_t, eytzinger_layout>(capacity));
+  } else if (structure == "small_map") {
+    dict.reset(new small_map_dict<uint32_t>(capacity));
+  }
+  return dict;
+}
 
-  // parse commandline arguments
+// Create a Dict with capacity n, as make_dict would.
+template <typename Dict>
+unique_ptr<abstract_dict<uint32_t>> new_dict(size_t n) {
+  return unique_ptr<abstract_dict<uint32_t>>(new Dict(n));
+}
 
-  vector<string> arguments(argv, argv + argc);
+// For each map size from 4 to 64, create maps tables of that size one
+// after another with each of a few structures: insert the keys, look each
+// one up, look up as many absent keys, and destroy the table. Print the
+// time per map and per operation, which for tiny maps is dominated by
+// allocation and hashing rather than by cache misses. Each structure's
+// constructor is chosen once, so looking up its name in make_dict is not
+// timed for every map.
+int run_small_maps(unsigned maps) {
+  using clock = chrono::high_resolution_clock;
+  typedef unique_ptr<abstract_dict<uint32_t>> (*factory)(size_t);
+  const vector<pair<string, factory>> structures{
+    {"small_map", new_dict<small_map_dict<uint32_t>>},
+    {"naive", new_dict<naive_dict<uint32_t>>},
+    {"chain", new_dict<chain_dict<uint32_t>>},
+    {"swiss", new_dict<swiss_dict<uint32_t>>},
+    {"lp_simd", new_dict<flat_lp_dict<uint32_t>>}};
+  const unsigned distinct = 256;      // key sets, cycled through by the maps
 
-  if (arguments.size() != 3) {
-    print_usage();
-    return 1;
+  cout << "size, structure, ns per map, ns per operation" << endl;
+  for (unsigned size : {4u, 8u, 16u, 32u, 64u}) {
+    mt19937 gen(SEED);
+    vector<uint32_t> keys(size_t(distinct) * size * 2);   // present then absent, per set
+    for (auto& key : keys) {
+      key = gen();
+    }
+
+    for (const auto& named : structures) {
+      const string& structure = named.first;
+      uint64_t found = 0;
+      auto start = clock::now();
+      for (unsigned m = 0; m < maps; ++m) {
+        const uint32_t* present = &keys[size_t(m % distinct) * size * 2];
+        const uint32_t* absent = present + size;
+        auto dict = named.second(size);
+        for (unsigned i = 0; i < size; ++i) {
+          dict->set(present[i], uint32_t(i));
+        }
+        for (unsigned i = 0; i < size; ++i) {
+          found += dict->contains(present[i]);
+          found += dict->contains(absent[i]);
+        }
+      }
+      auto end = clock::now();
+
+      if (found != uint64_t(maps) * size) {
+        cout << "error: " << structure << " found " << found << " keys, expected "
+             << uint64_t(maps) * size << endl;
+        return 1;
+      }
+      double ns = chrono::duration_cast<chrono::duration<double>>(end - start).count() * 1e9;
+      cout << size << ", " << structure << ", " << ns / maps << ", "
+           << ns / maps / (3.0 * size) << endl;
+    }
   }
+  return 0;
+}
 
-  auto& structure = arguments[1],
-        n_string = arguments[2];
+// Thread counts from 1 up to the number of hardware threads, doubling.
+vector<unsigned> thread_counts() {
+  unsigned cores = max(1u, thread::hardware_concurrency());
+  vector<unsigned> counts;
+  for (unsigned threads = 1; threads < cores; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(cores);
+  return counts;
+}
 
-  unsigned n;
-  try {
-    int parsed{stoi(n_string)};
-    if (parsed <= 0) {
-      cout << "error: input size " << parsed << " must be positive" << endl;
-      return 1;
+// Look up every key of present and absent from each of 1 to all cores'
+// reader threads at once, through a const reference to dict, and print the
+// lookup throughput at each thread count.
+int run_reader_scaling(const abstract_dict<uint32_t>& dict,
+                       const vector<uint32_t>& present,
+                       const vector<uint32_t>& absent) {
+  using clock = chrono::high_resolution_clock;
+
+  // interleave hits and misses so every thread sees the same mix
+  vector<uint32_t> keys;
+  for (size_t i = 0; i < max(present.size(), absent.size()); ++i) {
+    if (i < present.size()) {
+      keys.push_back(present[i]);
+    }
+    if (i < absent.size()) {
+      keys.push_back(absent[i]);
     }
-    n = parsed;
-  } catch (std::invalid_argument e) {
-    cout << "error: '" << n_string << "' is not an integer" << endl;
-    return 1;
   }
-  assert(n > 0);
 
-  unique_ptr<abstract_dict<uint32_t>> dict;
-  if (structure == "naive") {
-    dict.reset(new naive_dict<uint32_t>(n));
-  } else if (structure == "chain") {
-    dict.reset(new chain_dict<uint32_t>(n));
-  } else if (structure == "lp") {
-    dict.reset(new lp_dict<uint32_t>(n));
-  } else if (structure == "cuckoo") {
-    dict.reset(new cuckoo_dict<uint32_t>(n));
-  } else {
-    print_usage();
-    return 1;
+  cout << "threads, lookups, seconds, total Mlookups/s, Mlookups/s per thread" << endl;
+  for (unsigned threads : thread_counts()) {
+    vector<size_t> hits(threads, 0);
+    vector<thread> readers;
+
+    auto start = clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+      readers.emplace_back([&, t]() {
+        // each reader starts at a different offset, so they do not walk the
+        // table in lockstep
+        size_t offset = keys.size() * t / threads, found = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+          uint32_t key = keys[(offset + i) % keys.size()];
+          const uint32_t* value = dict.find(key);
+          found += (value != nullptr && *value == key + 1);
+        }
+        hits[t] = found;
+      });
+    }
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    auto end = clock::now();
+
+    for (unsigned t = 0; t < threads; ++t) {
+      if (hits[t] != present.size()) {
+        cout << "error: reader " << t << " found " << hits[t] << " of "
+             << present.size() << " present keys" << endl;
+        return 1;
+      }
+    }
+
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    double lookups = double(keys.size()) * threads;
+    cout << threads << ", " << lookups << ", " << seconds << ", "
+         << lookups / seconds / 1e6 << ", " << lookups / seconds / 1e6 / threads << endl;
   }
-  assert(dict);
+  return 0;
+}
 
-  // print parameters
-  cout << "== dictionary benchmark ==" << endl
-       << "structure: " << structure << endl
-       << "n: " << n << endl;
+// Time n lookups of keys with the table probing at the given level. Return
+// nanoseconds per lookup, or a negative number if a lookup gave the wrong
+// answer.
+double time_flat_lookups(flat_lp_dict<uint32_t>& dict, simd_level level,
+                         const vector<uint32_t>& keys, bool present) {
+  using clock = chrono::high_resolution_clock;
+  dict.use_simd(level);
+  size_t found = 0;
+  auto start = clock::now();
+  for (auto x : keys) {
+    uint32_t* value = dict.find(x);
+    found += (value != nullptr && *value == x + 1);
+  }
+  auto end = clock::now();
+  if (found != (present ? keys.size() : 0)) {
+    return -1;
+  }
+  return chrono::duration_cast<chrono::duration<double, nano>>(end - start).count() / keys.size();
+}
 
+// Fill an lp_simd table of about n slots to each load factor in turn, and
+// print the time per hit and per miss with scalar and SIMD probing.
+int run_load_sweep(unsigned n) {
+  const simd_level simd = detect_simd();
+  cout << "== flat linear probing load sweep ==" << endl
+       << "slots: " << flat_lp_dict<uint32_t>(n).table_size() << endl
+       << "simd: " << simd_level_name(simd) << endl
+       << "load, scalar hit ns, simd hit ns, hit speedup, scalar miss ns, simd miss ns, miss speedup" << endl;
 
-  cout << "generating input..." << flush;
-  vector<uint32_t> first_half,   // n/2 elements to insert
-                   second_half,  // remaining n/2 elements to insert
-                   absent; // n/2 elements to search for, that were never inserted
-  {
-    const unsigned half_n = n / 2,
-      total_n = half_n * 3;
+  for (double load : {0.5, 0.6, 0.7, 0.8, 0.85, 0.9, 0.95}) {
+    flat_lp_dict<uint32_t> dict(n);
+    const size_t count = size_t(load * dict.table_size());
 
-    // Create a random permutation of [0, total_n). This guarantees all
-    // values are distinct.
+    // present keys are a random subset of [0, 2*count), absent keys the rest
     mt19937 gen(SEED);
-    std::vector<uint32_t> randoms(total_n);
-    for (unsigned i = 0; i < total_n; ++i) {
+    vector<uint32_t> randoms(count * 2);
+    for (size_t i = 0; i < randoms.size(); ++i) {
       randoms[i] = i;
     }
     std::shuffle(randoms.begin(), randoms.end(), gen);
+    vector<uint32_t> present(randoms.begin(), randoms.begin() + count),
+                     absent(randoms.begin() + count, randoms.end());
+
+    for (auto x : present) {
+      dict.set(x, x + 1);
+    }
+
+    double scalar_hit = time_flat_lookups(dict, simd_level::scalar, present, true),
+           simd_hit = time_flat_lookups(dict, simd, present, true),
+           scalar_miss = time_flat_lookups(dict, simd_level::scalar, absent, false),
+           simd_miss = time_flat_lookups(dict, simd, absent, false);
+    if (scalar_hit < 0 || simd_hit < 0 || scalar_miss < 0 || simd_miss < 0) {
+      cout << "error: lookups at load " << load << " gave wrong results" << endl;
+      return 1;
+    }
+    cout << load << ", " << scalar_hit << ", " << simd_hit << ", " << scalar_hit / simd_hit
+         << ", " << scalar_miss << ", " << simd_miss << ", " << scalar_miss / simd_miss << endl;
+  }
+  return 0;
+}
 
-    // Divide up the elements
-    first_half.assign(randoms.begin(), randoms.begin() + half_n);
-    second_half.assign(randoms.begin() + half_n, randoms.begin() + half_n * 2);
-    absent.assign(randoms.begin() + half_n * 2, randoms.end());
+// Create the concurrent dictionary named structure, with capacity n, or
+// return null if structure is not the name of one.
+unique_ptr<abstract_concurrent_dict<uint32_t>> make_concurrent_dict(const string& structure, unsigned n) {
+  unique_ptr<abstract_concurrent_dict<uint32_t>> dict;
+  if (structure == "striped_chain") {
+    dict.reset(new striped_chain_dict<uint32_t>(n));
+  } else if (structure == "lockfree_lp") {
+    dict.reset(new lockfree_lp_dict<uint32_t>(n));
+  } else if (structure == "concurrent_cuckoo") {
+    dict.reset(new concurrent_cuckoo_dict<uint32_t>(n));
+  } else if (structure == "sharded_chain") {
+    dict.reset(new sharded_dict<uint32_t, chain_dict<uint32_t>>(n));
   }
+  return dict;
+}
 
-  auto check_all_present = [&](const vector<uint32_t>& vec) {
-    for (auto x : vec) {
-      try {
-	auto& searched_value = dict->search(x);
-	uint32_t expected_value = x + 1;
-	if (searched_value != expected_value) {
-	  cout << "error: search(" << x << ") found value " << searched_value
-	       << ", which should be " << expected_value << endl;
-	  return true;
-	}
-      } catch (std::out_of_range e) {
-	cout << "error: search(" << x << ") failed";
-	return true;
+// Fill a fresh concurrent table with preload, then have 1, 2, 4, ... up to
+// all cores' threads each run n operations on it at once: 80% find, 10% set
+// and 10% erase, on keys drawn uniformly from keys. Print the throughput at
+// each thread count.
+int run_mixed_scaling(const string& structure, unsigned n,
+                      const vector<uint32_t>& preload, const vector<uint32_t>& keys) {
+  using clock = chrono::high_resolution_clock;
+
+  cout << "threads, operations, seconds, total Mops/s, Mops/s per thread, contended locks" << endl;
+  for (unsigned threads : thread_counts()) {
+    auto dict = make_concurrent_dict(structure, n);
+    for (auto x : preload) {
+      dict->set(x, x >> 1);
+    }
+
+    atomic<bool> failed{false};
+    vector<thread> workers;
+    auto start = clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t]() {
+        mt19937 gen(SEED + t);
+        for (unsigned i = 0; i < n; ++i) {
+          uint32_t key = keys[gen() % keys.size()], value;
+          unsigned op = gen() % 10;
+          if (op < 8) {
+            if (dict->find(key, value) && value != key >> 1) {
+              failed = true;
+            }
+          } else if (op == 8) {
+            dict->set(key, key >> 1);
+          } else {
+            dict->erase(key);
+          }
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    auto end = clock::now();
+
+    if (failed) {
+      cout << "error: a find returned the wrong value" << endl;
+      return 1;
+    }
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    double ops = double(n) * threads;
+    cout << threads << ", " << ops << ", " << seconds << ", " << ops / seconds / 1e6 << ", "
+         << ops / seconds / 1e6 / threads << ", " << dict->contention() << endl;
+  }
+  return 0;
+}
+
+// Fill a fresh concurrent table with resident, then have 1, 2, 4, ... up to
+// all cores' reader threads each look up every resident key while one more
+// thread keeps setting and erasing the churn keys. Print the reader
+// throughput, which the writer should disturb as little as possible, and
+// check that no reader ever misses a resident key.
+int run_readers_under_writes(const string& structure, unsigned n,
+                             const vector<uint32_t>& resident, const vector<uint32_t>& churn) {
+  using clock = chrono::high_resolution_clock;
+
+  cout << "readers, lookups, seconds, total Mlookups/s, Mlookups/s per reader, "
+       << "writer Mops/s, contention" << endl;
+  for (unsigned threads : thread_counts()) {
+    auto dict = make_concurrent_dict(structure, n);
+    for (auto x : resident) {
+      dict->set(x, x >> 1);
+    }
+
+    // the writer also runs while readers start up and shut down, so its
+    // throughput counts only the writes made between start and end
+    atomic<bool> stop{false};
+    atomic<uint64_t> writes{0};
+    thread writer([&]() {
+      auto wrote = [&]() { writes.fetch_add(1, memory_order_relaxed); };
+      // insert all the churn keys, which evicts resident ones in a cuckoo
+      // table, then erase them all, and repeat
+      while (!stop && !churn.empty()) {
+        for (size_t i = 0; i < churn.size() && !stop; ++i, wrote()) {
+          dict->set(churn[i], churn[i] >> 1);
+        }
+        for (size_t i = 0; i < churn.size() && !stop; ++i, wrote()) {
+          dict->erase(churn[i]);
+        }
       }
+    });
+
+    vector<size_t> hits(threads, 0);
+    vector<thread> readers;
+    uint64_t writes_at_start = writes.load();
+    auto start = clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+      readers.emplace_back([&, t]() {
+        size_t offset = resident.size() * t / threads, found = 0;
+        for (size_t i = 0; i < resident.size(); ++i) {
+          uint32_t key = resident[(offset + i) % resident.size()], value;
+          found += (dict->find(key, value) && value == key >> 1);
+        }
+        hits[t] = found;
+      });
     }
-    return false;
-  };
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    auto end = clock::now();
+    uint64_t timed_writes = writes.load() - writes_at_start;
+    stop = true;
+    writer.join();
 
-  auto check_all_absent = [&](const vector<uint32_t>& vec) {
-    for (auto x : vec) {
-      try {
-	auto& searched_value = dict->search(x);
-	cout << "error: search(" << x << ") found value " << searched_value
-	     << ", but that key shouldn't be present" << endl;
-	return true;
-      } catch (std::out_of_range e) {
-	// do nothing, expected to throw
+    for (unsigned t = 0; t < threads; ++t) {
+      if (hits[t] != resident.size()) {
+        cout << "error: reader " << t << " found " << hits[t] << " of "
+             << resident.size() << " resident keys" << endl;
+        return 1;
       }
     }
-    return false;
-  };
-  
-  cout << endl << "inserting and searching for " << n << " elements..." << flush;
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    double lookups = double(resident.size()) * threads;
+    cout << threads << ", " << lookups << ", " << seconds << ", " << lookups / seconds / 1e6 << ", "
+         << lookups / seconds / 1e6 / threads << ", " << timed_writes / seconds / 1e6 << ", "
+         << dict->contention() << endl;
+  }
+  return 0;
+}
+
+// Build a Dict of the keys of present with parallel_build_from on 1, 2, 4,
+// ... up to all cores' threads, check that every key of present is found
+// and none of absent, and print the build throughput and the time per hit
+// and per miss on the built table at each thread count.
+template <typename Dict>
+int run_build_scaling(const vector<uint32_t>& present, const vector<uint32_t>& absent) {
+  using clock = chrono::high_resolution_clock;
+
+  vector<pair<uint32_t, uint32_t>> pairs;
+  for (auto x : present) {
+    pairs.emplace_back(x, x + 1);
+  }
+
+  cout << "threads, keys, seconds, Mkeys/s, speedup, hit ns, miss ns" << endl;
+  double one_thread = 0;
+  for (unsigned threads : thread_counts()) {
+    auto start = clock::now();
+    auto dict = Dict::parallel_build_from(pairs.data(), pairs.size(), threads);
+    auto end = clock::now();
+
+    for (auto x : present) {
+      const uint32_t* value = dict->find(x);
+      if (value == nullptr || *value != x + 1) {
+        cout << "error: key " << x << " missing after a build on " << threads << " threads" << endl;
+        return 1;
+      }
+    }
+    auto misses_start = clock::now();
+    for (auto x : absent) {
+      if (dict->find(x) != nullptr) {
+        cout << "error: absent key " << x << " found after a build on " << threads << " threads" << endl;
+        return 1;
+      }
+    }
+    auto misses_end = clock::now();
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count(),
+           hit_seconds = chrono::duration_cast<chrono::duration<double>>(misses_start - end).count(),
+           miss_seconds = chrono::duration_cast<chrono::duration<double>>(misses_end - misses_start).count();
+    if (threads == 1) {
+      one_thread = seconds;
+    }
+    cout << threads << ", " << pairs.size() << ", " << seconds << ", "
+         << pairs.size() / seconds / 1e6 << ", " << one_thread / seconds << ", "
+         << hit_seconds * 1e9 / max<size_t>(present.size(), 1) << ", "
+         << miss_seconds * 1e9 / max<size_t>(absent.size(), 1) << endl;
+  }
+  return 0;
+}
+
+// Build a Dict with build_from from pairs giving each key x of present the
+// value x + 1, followed by the first tenth of them again with the value
+// x + 2, and fill a fresh make_dict(structure, present.size(), load)
+// table with each key's last value through set (once per key, since
+// cuckoo_dict's set does not replace); load should be the load factor
+// build_from sizes its table for, so both tables are equally full. Check
+// that both tables give every key of present and absent the same value,
+// and print the time each method took, the time per hit and per miss on
+// its table, and a checksum of the values found.
+template <typename Dict>
+int run_bulk_build(const string& structure, double load, const vector<uint32_t>& present,
+                   const vector<uint32_t>& absent) {
+  using clock = chrono::high_resolution_clock;
+
+  vector<pair<uint32_t, uint32_t>> pairs;
+  for (auto x : present) {
+    pairs.emplace_back(x, x + 1);
+  }
+  for (size_t i = 0; i < present.size() / 10; ++i) {
+    pairs.emplace_back(present[i], present[i] + 2);
+  }
+
+  auto build_start = clock::now();
+  unique_ptr<abstract_dict<uint32_t>> built(Dict::build_from(pairs.data(), pairs.size()).release());
+  auto build_end = clock::now();
+  auto inserted = make_dict(structure, present.size(), load);
+  for (size_t i = 0; i < present.size(); ++i) {
+    inserted->set(present[i], present[i] + (i < present.size() / 10 ? 2 : 1));
+  }
+  auto insert_end = clock::now();
+
+  for (const vector<uint32_t>* keys : {&present, &absent}) {
+    for (auto x : *keys) {
+      const uint32_t* expected = inserted->find(x);
+      const uint32_t* value = built->find(x);
+      if ((value == nullptr) != (expected == nullptr) || (value && *value != *expected)) {
+        cout << "error: build_from and set disagree on key " << x << endl;
+        return 1;
+      }
+    }
+  }
 
-  // start high resolution clock
+  cout << "method, pairs, seconds, Mpairs/s, hit ns, miss ns, checksum" << endl;
+  const pair<const char*, abstract_dict<uint32_t>*> methods[] = {
+    {"build_from", built.get()}, {"set", inserted.get()}};
+  for (auto& method : methods) {
+    bool building = (method.second == built.get());
+    auto start = building ? build_start : build_end;
+    auto end = building ? build_end : insert_end;
+    size_t count = building ? pairs.size() : present.size();
+    uint64_t checksum = 0;
+    auto hits_start = clock::now();
+    for (auto x : present) {
+      checksum += *method.second->find(x);
+    }
+    auto misses_start = clock::now();
+    for (auto x : absent) {
+      checksum += (method.second->find(x) != nullptr);
+    }
+    auto misses_end = clock::now();
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count(),
+           hit_seconds = chrono::duration_cast<chrono::duration<double>>(misses_start - hits_start).count(),
+           miss_seconds = chrono::duration_cast<chrono::duration<double>>(misses_end - misses_start).count();
+    cout << method.first << ", " << count << ", " << seconds << ", "
+         << count / seconds / 1e6 << ", "
+         << hit_seconds * 1e9 / max<size_t>(present.size(), 1) << ", "
+         << miss_seconds * 1e9 / max<size_t>(absent.size(), 1) << ", " << checksum << endl;
+  }
+  return 0;
+}
+
+// Fill a fresh concurrent table with preload, then run threads workers,
+// each pinned to its own core (round robin), for the given number of
+// seconds. Each operation is on a key drawn uniformly from keys: a find
+// with probability read_ratio, and otherwise a set or an erase with equal
+// chance. Print each worker's throughput, the total, and the contention
+// the table counted.
+int run_timed_mix(const string& structure, unsigned n, unsigned threads,
+                  double read_ratio, double duration,
+                  const vector<uint32_t>& preload, const vector<uint32_t>& keys) {
   using clock = chrono::high_resolution_clock;
+
+  auto dict = make_concurrent_dict(structure, n);
+  for (auto x : preload) {
+    dict->set(x, x >> 1);
+  }
+
+  unsigned cores = max(1u, thread::hardware_concurrency());
+  uint32_t read_threshold = uint32_t(min(1.0, max(0.0, read_ratio)) * 0xFFFFFFFFu);
+  atomic<bool> go{false}, stop{false}, failed{false};
+  atomic<unsigned> unpinned{0};
+  vector<uint64_t> ops(threads, 0);
+  vector<thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      if (!pin_to_core(t % cores)) {
+        unpinned++;
+      }
+      mt19937 gen(SEED + t);
+      uint64_t done = 0;
+      while (!go) {
+        this_thread::yield();
+      }
+      while (!stop.load(memory_order_relaxed)) {
+        uint32_t key = keys[gen() % keys.size()], value;
+        if (gen() <= read_threshold) {
+          if (dict->find(key, value) && value != key >> 1) {
+            failed = true;
+          }
+        } else if (gen() & 1) {
+          dict->set(key, key >> 1);
+        } else {
+          dict->erase(key);
+        }
+        ++done;
+      }
+      ops[t] = done;
+    });
+  }
+
   auto start = clock::now();
+  go = true;
+  this_thread::sleep_for(chrono::duration<double>(duration));
+  stop = true;
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  auto end = clock::now();
 
-  // all elements should be absent
-  if (check_all_absent(first_half)) {
+  if (failed) {
+    cout << "error: a find returned the wrong value" << endl;
     return 1;
   }
-  if (check_all_absent(second_half)) {
-    return 1;
+  if (unpinned > 0) {
+    cout << "warning: " << unpinned << " of " << threads << " workers could not be pinned" << endl;
+  }
+  double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+  uint64_t total = 0;
+  cout << "thread, operations, Mops/s" << endl;
+  for (unsigned t = 0; t < threads; ++t) {
+    total += ops[t];
+    cout << t << ", " << ops[t] << ", " << ops[t] / seconds / 1e6 << endl;
+  }
+  uint64_t contention = dict->contention();
+  cout << "total operations: " << total << " in " << seconds << " seconds" << endl
+       << "total throughput: " << total / seconds / 1e6 << " Mops/s" << endl
+       << "per-thread throughput: " << total / seconds / 1e6 / threads << " Mops/s" << endl
+       << "contention: " << contention << " (" << (total ? double(contention) / total : 0.0)
+       << " per operation)" << endl;
+  return 0;
+}
+
+// Build a snapshot table of resident, then have 1, 2, 4, ... up to all
+// cores' reader threads each look up every resident and every absent key,
+// interleaved, while one more thread keeps building and publishing new
+// tables, alternately with and without the churn keys. Print the reader
+// throughput and the number of tables published meanwhile, and check that
+// no reader ever misses a resident key or finds an absent one.
+template <typename Dict>
+int run_snapshot_readers(const vector<uint32_t>& resident, const vector<uint32_t>& churn,
+                         const vector<uint32_t>& absent) {
+  using clock = chrono::high_resolution_clock;
+
+  vector<pair<uint32_t, uint32_t>> small, large;
+  for (auto x : resident) {
+    small.emplace_back(x, x >> 1);
+  }
+  large = small;
+  for (auto x : churn) {
+    large.emplace_back(x, x >> 1);
+  }
+
+  cout << "readers, lookups, seconds, total Mlookups/s, Mlookups/s per reader, tables published" << endl;
+  for (unsigned threads : thread_counts()) {
+    snapshot_dict<uint32_t, Dict> dict(small.data(), small.size());
+
+    atomic<bool> stop{false};
+    thread publisher([&]() {
+      for (bool with_churn = true; !stop; with_churn = !with_churn) {
+        const auto& pairs = with_churn ? large : small;
+        dict.rebuild(pairs.data(), pairs.size());
+      }
+    });
+
+    vector<size_t> hits(threads, 0), false_hits(threads, 0);
+    vector<thread> readers;
+    auto start = clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+      readers.emplace_back([&, t]() {
+        size_t offset = resident.size() * t / threads, found = 0, wrongly_found = 0;
+        for (size_t i = 0; i < max(resident.size(), absent.size()); ++i) {
+          uint32_t value;
+          if (i < resident.size()) {
+            uint32_t key = resident[(offset + i) % resident.size()];
+            found += (dict.find(key, value) && value == key >> 1);
+          }
+          if (i < absent.size()) {
+            wrongly_found += dict.find(absent[i], value);
+          }
+        }
+        hits[t] = found;
+        false_hits[t] = wrongly_found;
+      });
+    }
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    auto end = clock::now();
+    uint64_t published = dict.publications();
+    stop = true;
+    publisher.join();
+
+    for (unsigned t = 0; t < threads; ++t) {
+      if (hits[t] != resident.size()) {
+        cout << "error: reader " << t << " found " << hits[t] << " of "
+             << resident.size() << " resident keys" << endl;
+        return 1;
+      }
+      if (false_hits[t] != 0) {
+        cout << "error: reader " << t << " found " << false_hits[t] << " absent keys" << endl;
+        return 1;
+      }
+    }
+    double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    double lookups = double(resident.size() + absent.size()) * threads;
+    cout << threads << ", " << lookups << ", " << seconds << ", " << lookups / seconds / 1e6 << ", "
+         << lookups / seconds / 1e6 / threads << ", " << published << endl;
+  }
+  return 0;
+}
+
+// Print the probe length statistics of dict, if it is a Dict.
+template <typename Dict>
+void print_probe_lengths(abstract_dict<uint32_t>* dict) {
+  if (auto probed = dynamic_cast<Dict*>(dict)) {
+    probe_stats probes = probed->probe_lengths();
+    cout << "load factor: " << probes.load_factor << endl
+         << "max probe length: " << probes.max_length << endl
+         << "mean probe length: " << probes.mean_length << endl;
+  }
+}
+
+// Time 1000 range scans of about 100 keys each, starting at keys drawn
+// from present, if dict is an ordered Dict, and check that every scan
+// visits keys in increasing order.
+template <typename Dict>
+int print_range_scans(abstract_dict<uint32_t>* dict, const vector<uint32_t>& present) {
+  auto ordered = dynamic_cast<Dict*>(dict);
+  if (ordered == nullptr || present.empty()) {
+    return 0;
+  }
+  using clock = chrono::high_resolution_clock;
+  const unsigned scans = 1000;
+  auto bounds = minmax_element(present.begin(), present.end());
+  uint64_t width = (uint64_t(*bounds.second) - *bounds.first) * 100 / present.size();
+  mt19937 gen(SEED);
+  size_t visited = 0;
+  bool sorted = true;
+  auto start = clock::now();
+  for (unsigned i = 0; i < scans; ++i) {
+    uint32_t low = present[gen() % present.size()],
+             high = uint32_t(min<uint64_t>(0xFFFFFFFFu, low + width));
+    uint64_t previous = low;
+    visited += ordered->scan(low, high, [&](uint32_t key, const uint32_t&) {
+      sorted &= (key >= previous);
+      previous = uint64_t(key) + 1;
+    });
   }
-  if (check_all_absent(absent)) {
+  auto end = clock::now();
+  if (!sorted) {
+    cout << "error: a range scan visited keys out of order" << endl;
     return 1;
   }
-  
-  // insert first_half
+  double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+  cout << "range scans: " << visited << " keys in " << scans << " scans, "
+       << (visited ? seconds * 1e9 / visited : 0.0) << " ns per key" << endl;
+  return 0;
+}
+
+// Return true, after printing an error, unless every key of keys is in
+// dict with the value key + 1.
+bool check_all_present(const abstract_dict<uint32_t>& dict, const vector<uint32_t>& keys) {
+  for (auto x : keys) {
+    auto searched_value = dict.find(x);
+    if (searched_value == nullptr) {
+      cout << "error: search(" << x << ") failed" << endl;
+      return true;
+    }
+    uint32_t expected_value = x + 1;
+    if (*searched_value != expected_value) {
+      cout << "error: search(" << x << ") found value " << *searched_value
+           << ", which should be " << expected_value << endl;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Return true, after printing an error, if any key of keys is in dict.
+bool check_all_absent(const abstract_dict<uint32_t>& dict, const vector<uint32_t>& keys) {
+  for (auto x : keys) {
+    auto searched_value = dict.find(x);
+    if (searched_value != nullptr) {
+      cout << "error: search(" << x << ") found value " << *searched_value
+           << ", but that key shouldn't be present" << endl;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hardware event counts over a region of code, from Linux perf_event_open,
+// counting user-space events of this thread only. Each event is opened on
+// its own, so an event the CPU or kernel cannot count is just left out;
+// elsewhere than Linux no event is available. When there are more events
+// than hardware counters the kernel multiplexes them, and counts are scaled
+// up by the fraction of the time each event was actually counted.
+class perf_counters {
+public:
+  static const size_t EVENTS = 6;
+
+  perf_counters() {
+    fds_.fill(-1);
+#if defined(__linux__)
+    const pair<uint32_t, uint64_t> events[EVENTS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},     // usually last-level misses
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+    for (size_t i = 0; i < EVENTS; ++i) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[i].first;
+      attr.config = events[i].second;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fds_[i] < 0 && error_.empty()) {
+        error_ = strerror(errno);
+      }
+    }
+#else
+    error_ = "hardware counters are only read on Linux";
+#endif
+  }
+
+  ~perf_counters() {
+#if defined(__linux__)
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  static const char* name(size_t event) noexcept {
+    static const char* const names[EVENTS] = {
+      "cycles", "instructions", "L1D misses", "LLC misses", "dTLB misses", "branch misses"};
+    return names[event];
+  }
+
+  bool available(size_t event) const noexcept { return fds_[event] >= 0; }
+
+  bool any_available() const noexcept {
+    return any_of(fds_.begin(), fds_.end(), [](int fd) { return fd >= 0; });
+  }
+
+  // Why the first unavailable event could not be opened.
+  const string& error() const noexcept { return error_; }
+
+  void start() noexcept {
+#if defined(__linux__)
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  // Stop counting and store each event's count since start in counts, or
+  // -1 for an event that is unavailable or was never scheduled.
+  void stop(array<double, EVENTS>& counts) noexcept {
+    counts.fill(-1);
+#if defined(__linux__)
+    for (size_t i = 0; i < EVENTS; ++i) {
+      if (fds_[i] >= 0) {
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (size_t i = 0; i < EVENTS; ++i) {
+      uint64_t values[3];                 // count, time enabled, time running
+      if (fds_[i] >= 0 && read(fds_[i], values, sizeof(values)) == ssize_t(sizeof(values)) &&
+          values[2] > 0) {
+        counts[i] = double(values[0]) * values[1] / values[2];
+      }
+    }
+#endif
+  }
+
+private:
+  array<int, EVENTS> fds_;
+  string error_;
+};
+
+// The running time of one phase of the main benchmark, and its hardware
+// event counts when they were collected (see perf_counters::stop).
+struct phase_time {
+  const char* name;
+  size_t operations;
+  double seconds;
+  array<double, perf_counters::EVENTS> counts;
+};
+
+// Fill the empty dict with first_half and then second_half, checking all
+// three key sets before and after each insert, and append the time of each
+// of the seven phases to phases, with hardware event counts if counters is
+// not null. Returns 0 on success, or 1 after printing an error.
+int run_phases(abstract_dict<uint32_t>& dict,
+               const vector<uint32_t>& first_half,
+               const vector<uint32_t>& second_half,
+               const vector<uint32_t>& absent,
+               bool batch_insert,
+               vector<phase_time>& phases,
+               perf_counters* counters = nullptr) {
+  using clock = chrono::high_resolution_clock;
+
+  // values for insert_batch, prepared outside the timed region
+  vector<uint32_t> first_values, second_values;
   for (auto x : first_half) {
-    dict->set(x, x + 1);
+    first_values.push_back(x + 1);
+  }
+  for (auto x : second_half) {
+    second_values.push_back(x + 1);
   }
 
-  // only first_half should be present
-  if (check_all_present(first_half)) {
+  auto insert = [&](const vector<uint32_t>& keys, const vector<uint32_t>& values) {
+    if (batch_insert) {
+      dict.insert_batch(keys.data(), values.data(), keys.size());
+    } else {
+      for (auto x : keys) {
+        dict.set(x, x + 1);
+      }
+    }
+  };
+
+  // run body, which returns true on failure, as the phase name
+  auto timed = [&](const char* name, size_t operations, auto&& body) {
+    phase_time phase{name, operations, 0.0, {}};
+    if (counters) {
+      counters->start();
+    }
+    auto start = clock::now();
+    bool failed = body();
+    auto end = clock::now();
+    if (counters) {
+      counters->stop(phase.counts);
+    } else {
+      phase.counts.fill(-1);
+    }
+    phase.seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+    phases.push_back(phase);
+    return failed;
+  };
+
+  const size_t half_n = first_half.size();
+
+  // all elements should be absent
+  if (timed("empty-table misses", half_n + second_half.size() + absent.size(), [&]() {
+        return check_all_absent(dict, first_half) || check_all_absent(dict, second_half) ||
+               check_all_absent(dict, absent);
+      })) {
     return 1;
   }
-  if (check_all_absent(second_half)) {
+
+  if (timed("first-half insert", half_n, [&]() {
+        insert(first_half, first_values);
+        return false;
+      })) {
     return 1;
   }
-  if (check_all_absent(absent)) {
+
+  // only first_half should be present
+  if (timed("hits", half_n, [&]() { return check_all_present(dict, first_half); })) {
     return 1;
   }
-  
-  // insert second half
-  for (auto x : second_half) {
-    dict->set(x, x + 1);
+  if (timed("misses", second_half.size() + absent.size(), [&]() {
+        return check_all_absent(dict, second_half) || check_all_absent(dict, absent);
+      })) {
+    return 1;
   }
 
-  // only first_half and second_half should be present
-  if (check_all_present(first_half)) {
+  if (timed("second-half insert", second_half.size(), [&]() {
+        insert(second_half, second_values);
+        return false;
+      })) {
     return 1;
   }
-  if (check_all_present(second_half)) {
+
+  // only first_half and second_half should be present
+  if (timed("final hits", half_n + second_half.size(), [&]() {
+        return check_all_present(dict, first_half) || check_all_present(dict, second_half);
+      })) {
     return 1;
   }
-  if (check_all_absent(absent)) {
+  if (timed("final misses", absent.size(), [&]() { return check_all_absent(dict, absent); })) {
     return 1;
   }
+  return 0;
+}
 
-  // stop the clock
-  auto end = clock::now();
+// Print one line per phase, and their total as the elapsed time.
+void print_phases(const vector<phase_time>& phases) {
+  double total = 0;
+  cout << "phase, operations, seconds, ns per operation" << endl;
+  for (auto& phase : phases) {
+    cout << phase.name << ", " << phase.operations << ", " << phase.seconds << ", "
+         << (phase.operations ? phase.seconds * 1e9 / phase.operations : 0.0) << endl;
+    total += phase.seconds;
+  }
+  cout << "elapsed time: " << total << " seconds" << endl;
+}
 
-  // print elapsed time
-  double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
-  cout << endl << "elapsed time: " << seconds << " seconds" << endl;
+// Print the hardware event counts per operation of each phase, averaged
+// over runs, with n/a for events that were not counted.
+void print_phase_counters(const vector<vector<phase_time>>& runs) {
+  assert(!runs.empty());
+  cout << "hardware events per operation:" << endl
+       << "phase";
+  for (size_t e = 0; e < perf_counters::EVENTS; ++e) {
+    cout << ", " << perf_counters::name(e);
+  }
+  cout << ", instructions per cycle" << endl;
+  for (size_t p = 0; p < runs[0].size(); ++p) {
+    array<double, perf_counters::EVENTS> sums{};
+    array<bool, perf_counters::EVENTS> counted;
+    counted.fill(true);
+    for (auto& run : runs) {
+      for (size_t e = 0; e < perf_counters::EVENTS; ++e) {
+        counted[e] = counted[e] && run[p].counts[e] >= 0;
+        sums[e] += run[p].counts[e];
+      }
+    }
+    const double operations = double(max<size_t>(runs[0][p].operations, 1)) * runs.size();
+    cout << runs[0][p].name;
+    for (size_t e = 0; e < perf_counters::EVENTS; ++e) {
+      if (counted[e]) {
+        cout << ", " << sums[e] / operations;
+      } else {
+        cout << ", n/a";
+      }
+    }
+    if (counted[0] && counted[1] && sums[0] > 0) {
+      cout << ", " << sums[1] / sums[0] << endl;
+    } else {
+      cout << ", n/a" << endl;
+    }
+  }
+}
+
+// Summary of repeated measurements of one quantity.
+struct sample_stats {
+  double min, median, mean, stddev,
+         ci_low, ci_high;                // 95% confidence interval for the mean
+};
+
+sample_stats summarize(vector<double> samples) {
+  // two-sided 95% critical values of Student's t for 1 to 30 degrees of
+  // freedom; beyond that the normal value is close enough
+  static const double t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  assert(!samples.empty());
+  sort(samples.begin(), samples.end());
+  const size_t count = samples.size();
+  sample_stats stats;
+  stats.min = samples.front();
+  stats.median = (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+  double sum = 0;
+  for (double x : samples) {
+    sum += x;
+  }
+  stats.mean = sum / count;
+  double squares = 0;
+  for (double x : samples) {
+    squares += (x - stats.mean) * (x - stats.mean);
+  }
+  stats.stddev = (count > 1) ? sqrt(squares / (count - 1)) : 0.0;
+  double t = (count - 1 <= 30) ? t95[max<size_t>(count, 2) - 2] : 1.96;
+  double margin = t * stats.stddev / sqrt(double(count));
+  stats.ci_low = stats.mean - margin;
+  stats.ci_high = stats.mean + margin;
+  return stats;
+}
+
+// Print statistics over repeated runs of the phases, in ns per operation,
+// and the median total as the elapsed time.
+void print_phase_stats(const vector<vector<phase_time>>& runs) {
+  assert(!runs.empty());
+  cout << "phase, operations, min, median, mean, stddev, 95% CI low, 95% CI high (ns per operation, "
+       << runs.size() << " runs)" << endl;
+  auto print_row = [](const string& name, size_t operations, const vector<double>& seconds) {
+    vector<double> ns;
+    for (double x : seconds) {
+      ns.push_back(operations ? x * 1e9 / operations : 0.0);
+    }
+    sample_stats stats = summarize(ns);
+    cout << name << ", " << operations << ", " << stats.min << ", " << stats.median << ", "
+         << stats.mean << ", " << stats.stddev << ", " << stats.ci_low << ", " << stats.ci_high << endl;
+  };
+
+  size_t total_operations = 0;
+  vector<double> totals(runs.size(), 0.0);
+  for (size_t p = 0; p < runs[0].size(); ++p) {
+    vector<double> seconds;
+    for (size_t r = 0; r < runs.size(); ++r) {
+      seconds.push_back(runs[r][p].seconds);
+      totals[r] += runs[r][p].seconds;
+    }
+    print_row(runs[0][p].name, runs[0][p].operations, seconds);
+    total_operations += runs[0][p].operations;
+  }
+  print_row("all phases", total_operations, totals);
+  cout << "elapsed time: " << summarize(totals).median << " seconds (median)" << endl;
+}
+
+// Fill first_half and second_half with the n/2 keys each to insert, and
+// absent with n/2 keys that are never inserted, all in the given order
+// (see make_keys). Adversarial keys collide in target's table (see
+// make_colliding_keys).
+void generate_input(unsigned n,
+                    vector<uint32_t>& first_half,
+                    vector<uint32_t>& second_half,
+                    vector<uint32_t>& absent,
+                    key_order order = key_order::uniform,
+                    uint64_t stride = 1,
+                    const abstract_dict<uint32_t>* target = nullptr) {
+  const unsigned half_n = n / 2,
+    total_n = half_n * 3;
+
+  // Create total_n distinct keys; by default a random permutation of
+  // [0, total_n).
+  mt19937 gen(SEED);
+  vector<uint32_t> randoms = (order == key_order::adversarial)
+    ? make_colliding_keys(total_n, target->slots(), [&](uint32_t key) { return target->home(key); }, gen)
+    : make_keys(order, total_n, stride, gen);
+
+  // Divide up the elements
+  first_half.assign(randoms.begin(), randoms.begin() + half_n);
+  second_half.assign(randoms.begin() + half_n, randoms.begin() + half_n * 2);
+  absent.assign(randoms.begin() + half_n * 2, randoms.end());
+}
+
+// Parse "NAME" or "NAME:VALUE" into name and value, leaving value alone
+// when there is none. Returns false if VALUE is not a number.
+bool parse_option_value(const string& text, string& name, double& value) {
+  size_t colon = text.find(':');
+  name = text.substr(0, colon);
+  if (colon == string::npos) {
+    return true;
+  }
+  try {
+    size_t used;
+    value = stod(text.substr(colon + 1), &used);
+    return used == text.size() - colon - 1;
+  } catch (std::logic_error& e) {
+    return false;
+  }
+}
+
+const char* access_pattern_name(access_pattern pattern) {
+  switch (pattern) {
+  case access_pattern::zipf: return "zipf";
+  case access_pattern::hotspot: return "hotspot";
+  case access_pattern::latest: return "latest";
+  default: return "uniform";
+  }
+}
+
+// Timestamps for latency samples. Reads the time-stamp counter where
+// there is one, which costs far less than a clock call, and converts ticks
+// to nanoseconds with a rate calibrated against steady_clock; elsewhere
+// ticks are steady_clock nanoseconds.
+class latency_clock {
+public:
+  latency_clock() {
+#if HASHES_HAVE_X86
+    auto start = chrono::steady_clock::now();
+    uint64_t start_ticks = now();
+    while (chrono::steady_clock::now() - start < chrono::milliseconds(20)) { }
+    uint64_t ticks = now() - start_ticks;
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    ns_per_tick_ = (ticks > 0) ? ns / ticks : 1.0;
+#endif
+  }
+
+  uint64_t now() const noexcept {
+#if HASHES_HAVE_X86
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  double ns_per_tick() const noexcept { return ns_per_tick_; }
+
+private:
+  double ns_per_tick_ = 1.0;
+};
+
+// Log-bucketed histogram of latencies in the style of HdrHistogram. Values
+// below SUB_BUCKETS get a bucket each; above that, each power of two is
+// split into SUB_BUCKETS equal buckets, so every value is recorded to
+// within about 3% using a few thousand counters for the whole 64-bit range.
+class latency_histogram {
+public:
+  static const unsigned SUB_BITS = 5,
+                        SUB_BUCKETS = 1 << SUB_BITS;
+
+  latency_histogram() : counts_(SUB_BUCKETS * (65 - SUB_BITS), 0) { }
+
+  void record(uint64_t value) noexcept {
+    counts_[bucket_of(value)]++;
+    total_++;
+    max_ = max(max_, value);
+  }
+
+  uint64_t count() const noexcept { return total_; }
+  uint64_t max_value() const noexcept { return max_; }
+
+  // The highest value in the bucket holding the value at or below which a
+  // fraction p of the recorded values lie (capped at the maximum value).
+  uint64_t percentile(double p) const noexcept {
+    uint64_t rank = uint64_t(ceil(p * total_)), seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= max<uint64_t>(rank, 1)) {
+        return min(bucket_high(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  size_t buckets() const noexcept { return counts_.size(); }
+  uint64_t bucket_count(size_t i) const noexcept { return counts_[i]; }
+
+  // The range of values [bucket_low(i), bucket_high(i)] of bucket i.
+  static uint64_t bucket_low(size_t i) noexcept {
+    if (i < SUB_BUCKETS) {
+      return i;
+    }
+    size_t shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    return (SUB_BUCKETS + (i - SUB_BUCKETS) % SUB_BUCKETS) << shift;
+  }
+
+  static uint64_t bucket_high(size_t i) noexcept {
+    if (i < SUB_BUCKETS) {
+      return i;
+    }
+    size_t shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    return bucket_low(i) + ((uint64_t(1) << shift) - 1);
+  }
+
+private:
+  static size_t bucket_of(uint64_t value) noexcept {
+    if (value < SUB_BUCKETS) {
+      return size_t(value);
+    }
+    unsigned shift = highest_bit(value) - SUB_BITS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + size_t(value >> shift) - SUB_BUCKETS;
+  }
+
+  vector<uint64_t> counts_;
+  uint64_t total_ = 0,
+           max_ = 0;
+};
+
+// Print p50, p90, p99, p99.9 and max latency in ns of each named histogram,
+// whose values are clock ticks of ns_per_tick nanoseconds, sampled about 1
+// in sample operations. If csv_path is not empty also write every
+// histogram's nonempty buckets there, labelled with structure.
+int print_latencies(const string& structure, unsigned sample, double ns_per_tick,
+                    const vector<pair<const char*, const latency_histogram*>>& histograms,
+                    const string& csv_path) {
+  const double ns = ns_per_tick;
+  cout << "latency in ns, about 1 in " << sample << " operations sampled:" << endl
+       << "operation, samples, p50, p90, p99, p99.9, max" << endl;
+  for (auto& operation : histograms) {
+    const latency_histogram& histogram = *operation.second;
+    cout << operation.first << ", " << histogram.count();
+    for (double p : {0.5, 0.9, 0.99, 0.999}) {
+      cout << ", " << histogram.percentile(p) * ns;
+    }
+    cout << ", " << histogram.max_value() * ns << endl;
+  }
+
+  if (!csv_path.empty()) {
+    ofstream csv(csv_path);
+    csv << "structure,operation,low ns,high ns,count" << endl;
+    for (auto& operation : histograms) {
+      const latency_histogram& histogram = *operation.second;
+      for (size_t i = 0; i < histogram.buckets(); ++i) {
+        if (histogram.bucket_count(i) != 0) {
+          csv << structure << "," << operation.first << ","
+              << latency_histogram::bucket_low(i) * ns << ","
+              << latency_histogram::bucket_high(i) * ns << ","
+              << histogram.bucket_count(i) << endl;
+        }
+      }
+    }
+    if (!csv) {
+      cout << "error: could not write " << csv_path << endl;
+      return 1;
+    }
+    cout << "wrote " << csv_path << endl;
+  }
+  return 0;
+}
+
+// Run operations requests of a YCSB-style mix on a fresh make_dict table
+// named structure, which holds records (each key x with value x + 1),
+// choosing records by pattern (parameter as in record_chooser). Inserts
+// add the keys of spare in order, as the newest records. The table is
+// sized for the records and all the inserts drawn, at load factor load,
+// so the inserts never fill it. A scan of length l from key k visits the keys in
+// [k, k + l) in order on sorted dictionaries, and elsewhere looks up each
+// of them. Updates and read-modify-writes store x + 1 again, so every
+// record can be checked afterwards. The requests are drawn before the
+// clock starts. Print the operation counts and the throughput. If sample
+// is not 0, also time about one in sample requests, chosen at random
+// intervals as in run_latency, and print their latencies per operation as
+// print_latencies does; the throughput then includes the cost of those
+// timings.
+int run_ycsb(const string& structure, double load, const ycsb_mix& mix,
+             access_pattern pattern, double parameter,
+             vector<uint32_t> records, const vector<uint32_t>& spare,
+             size_t operations, unsigned sample, const string& csv_path) {
+  using clock = chrono::high_resolution_clock;
+  struct request {
+    ycsb_operation operation;
+    uint32_t key, length;
+    bool sampled;
+  };
+
+  mt19937 gen(SEED),
+          sample_gen(SEED);                       // apart, so sampling leaves the requests alone
+  uniform_int_distribution<unsigned> gap(1, 2 * max(sample, 1u) - 1);   // mean sample
+  unsigned countdown = gap(sample_gen);
+  record_chooser chooser(pattern, parameter, records.size());
+  uniform_int_distribution<uint32_t> scan_length(1, YCSB_MAX_SCAN);
+  vector<request> requests;
+  size_t counts[5] = {};
+  size_t inserted = 0;
+  for (size_t i = 0; i < operations; ++i) {
+    request next{mix.choose(gen), 0, 0, false};
+    if (next.operation == ycsb_operation::insert) {
+      if (inserted == spare.size()) {
+        cout << "error: the workload ran out of keys to insert after " << i
+             << " operations; use fewer --operations" << endl;
+        return 1;
+      }
+      next.key = spare[inserted++];
+      records.push_back(next.key);
+      chooser.grow(records.size());
+    } else {
+      next.key = records[chooser(gen)];
+      if (next.operation == ycsb_operation::scan) {
+        next.length = scan_length(gen);
+      }
+    }
+    if (sample && --countdown == 0) {
+      next.sampled = true;
+      countdown = gap(sample_gen);
+    }
+    counts[size_t(next.operation)]++;
+    requests.push_back(next);
+  }
+
+  auto table = make_dict(structure, records.size(), load);
+  abstract_dict<uint32_t>& dict = *table;
+  for (size_t i = 0; i < records.size() - inserted; ++i) {
+    dict.set(records[i], records[i] + 1);
+  }
+
+  unique_ptr<latency_clock> timer;                // calibrated only if sampling
+  if (sample) {
+    timer.reset(new latency_clock());
+  }
+  latency_histogram latencies[5];
+  uint64_t sample_start = 0;
+
+  auto sorted = dynamic_cast<sorted_dict<uint32_t>*>(&dict);
+  auto eytzinger = dynamic_cast<sorted_dict<uint32_t, eytzinger_layout>*>(&dict);
+  uint64_t checksum = 0;
+  auto add = [&](uint32_t, const uint32_t& value) { checksum += value; };
+
+  auto start = clock::now();
+  for (auto& next : requests) {
+    if (next.sampled) {
+      sample_start = timer->now();
+    }
+    switch (next.operation) {
+    case ycsb_operation::read:
+      if (auto value = dict.find(next.key)) {
+        checksum += *value;
+      }
+      break;
+    case ycsb_operation::update:
+    case ycsb_operation::insert:
+      dict.set(next.key, next.key + 1);
+      break;
+    case ycsb_operation::scan: {
+      uint32_t high = uint32_t(min<uint64_t>(0xFFFFFFFFu, uint64_t(next.key) + next.length - 1));
+      if (sorted) {
+        sorted->scan(next.key, high, add);
+      } else if (eytzinger) {
+        eytzinger->scan(next.key, high, add);
+      } else {
+        for (uint64_t key = next.key; key <= high; ++key) {
+          if (auto value = dict.find(uint32_t(key))) {
+            checksum += *value;
+          }
+        }
+      }
+      break;
+    }
+    case ycsb_operation::read_modify_write:
+      if (auto value = dict.find(next.key)) {
+        uint32_t modified = *value;
+        dict.set(next.key, std::move(modified));
+      }
+      break;
+    }
+    if (next.sampled) {
+      latencies[size_t(next.operation)].record(timer->now() - sample_start);
+    }
+  }
+  auto end = clock::now();
+
+  if (check_all_present(dict, records)) {
+    return 1;
+  }
+
+  double seconds = chrono::duration_cast<chrono::duration<double>>(end - start).count();
+  cout << "YCSB workload " << mix.name << ", " << access_pattern_name(pattern);
+  if (pattern != access_pattern::uniform) {
+    cout << " " << parameter;
+  }
+  cout << ", " << operations << " operations on " << (records.size() - inserted)
+       << " records (checksum " << checksum << "):" << endl
+       << "reads " << counts[size_t(ycsb_operation::read)]
+       << ", updates " << counts[size_t(ycsb_operation::update)]
+       << ", inserts " << counts[size_t(ycsb_operation::insert)]
+       << ", scans " << counts[size_t(ycsb_operation::scan)]
+       << ", read-modify-writes " << counts[size_t(ycsb_operation::read_modify_write)] << endl
+       << "seconds, Mops/s, ns per operation" << endl
+       << seconds << ", " << operations / seconds / 1e6 << ", "
+       << (operations ? seconds * 1e9 / operations : 0.0) << endl;
+
+  if (sample) {
+    static const char* const names[] = {"read", "update", "insert", "scan", "read-modify-write"};
+    vector<pair<const char*, const latency_histogram*>> histograms;
+    for (size_t i = 0; i < 5; ++i) {
+      if (counts[i] != 0) {
+        histograms.push_back({names[i], &latencies[i]});
+      }
+    }
+    return print_latencies(structure, sample, timer->ns_per_tick(), histograms, csv_path);
+  }
+  return 0;
+}
+
+// Split a comma-separated list into its items.
+vector<string> split_list(const string& list) {
+  vector<string> items;
+  stringstream stream(list);
+  string item;
+  while (getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+// Run program with the given arguments in a child process and collect
+// its standard output. Returns false if the child could not be started,
+// exited with an error, or was still running after timeout seconds, in
+// which case it is killed.
+bool run_child(const string& program, const vector<string>& arguments,
+               double timeout, string& output) {
+  output.clear();
+#if defined(_WIN32)
+  string command_line = "\"" + program + "\"";
+  for (auto& argument : arguments) {
+    command_line += " \"" + argument + "\"";
+  }
+
+  SECURITY_ATTRIBUTES inherit{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+  HANDLE read_end, write_end;
+  if (!CreatePipe(&read_end, &write_end, &inherit, 0)) {
+    return false;
+  }
+  SetHandleInformation(read_end, HANDLE_FLAG_INHERIT, 0);
+
+  STARTUPINFOA startup{};
+  startup.cb = sizeof(startup);
+  startup.dwFlags = STARTF_USESTDHANDLES;
+  startup.hStdOutput = write_end;
+  startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+  PROCESS_INFORMATION process{};
+  if (!CreateProcessA(nullptr, &command_line[0], nullptr, nullptr, TRUE, 0,
+                      nullptr, nullptr, &startup, &process)) {
+    CloseHandle(read_end);
+    CloseHandle(write_end);
+    return false;
+  }
+  CloseHandle(write_end);
+
+  // read until the child closes its end of the pipe, or time runs out
+  auto deadline = chrono::steady_clock::now() + chrono::duration<double>(timeout);
+  bool finished = false;
+  char buffer[4096];
+  while (chrono::steady_clock::now() < deadline) {
+    DWORD available = 0, received = 0;
+    if (!PeekNamedPipe(read_end, nullptr, 0, nullptr, &available, nullptr)) {
+      finished = true;                  // the child has exited
+      break;
+    }
+    if (available == 0) {
+      Sleep(10);
+      continue;
+    }
+    if (ReadFile(read_end, buffer, DWORD(min<size_t>(available, sizeof(buffer))), &received, nullptr)) {
+      output.append(buffer, received);
+    }
+  }
+  CloseHandle(read_end);
+
+  DWORD exit_code = 1;
+  if (!finished || WaitForSingleObject(process.hProcess, DWORD(max(0.0, timeout) * 1000)) != WAIT_OBJECT_0) {
+    TerminateProcess(process.hProcess, 1);
+    WaitForSingleObject(process.hProcess, INFINITE);
+  } else {
+    GetExitCodeProcess(process.hProcess, &exit_code);
+  }
+  CloseHandle(process.hThread);
+  CloseHandle(process.hProcess);
+  return finished && exit_code == 0;
+#else
+  int pipe_ends[2];
+  if (pipe(pipe_ends) != 0) {
+    return false;
+  }
+  pid_t child = fork();
+  if (child < 0) {
+    close(pipe_ends[0]);
+    close(pipe_ends[1]);
+    return false;
+  }
+  if (child == 0) {
+    dup2(pipe_ends[1], STDOUT_FILENO);
+    close(pipe_ends[0]);
+    close(pipe_ends[1]);
+    vector<char*> child_argv{const_cast<char*>(program.c_str())};
+    for (auto& argument : arguments) {
+      child_argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    child_argv.push_back(nullptr);
+    execvp(program.c_str(), child_argv.data());
+    _exit(127);
+  }
+  close(pipe_ends[1]);
+
+  // read until the child closes its end of the pipe, or time runs out
+  auto deadline = chrono::steady_clock::now() + chrono::duration<double>(timeout);
+  bool finished = false;
+  char buffer[4096];
+  for (auto now = chrono::steady_clock::now(); now < deadline; now = chrono::steady_clock::now()) {
+    pollfd readable{pipe_ends[0], POLLIN, 0};
+    int wait_ms = int(chrono::duration_cast<chrono::milliseconds>(deadline - now).count()) + 1;
+    if (poll(&readable, 1, wait_ms) <= 0) {
+      continue;
+    }
+    ssize_t received = read(pipe_ends[0], buffer, sizeof(buffer));
+    if (received <= 0) {
+      finished = true;
+      break;
+    }
+    output.append(buffer, size_t(received));
+  }
+  close(pipe_ends[0]);
+
+  int status = 0;
+  if (!finished) {
+    kill(child, SIGKILL);
+  }
+  waitpid(child, &status, 0);
+  return finished && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// Run the insert and search phases for each structure, size and load
+// factor, each in a child process of program (benchmark <STRUCTURE> <N>
+// --sweep-cell --load-factor <L>), and write the elapsed times to path as a CSV
+// with one row per structure (and load factor) and one column per size.
+// A cell whose process fails or outlives timeout seconds is written as
+// n/a. An empty loads runs each structure once, at its default capacity.
+// cell_options are passed on to every cell.
+int run_sweep(const string& program,
+              const vector<string>& structures,
+              const vector<unsigned>& sizes,
+              const vector<double>& loads,
+              double timeout,
+              const string& path,
+              const vector<string>& cell_options) {
+  struct row {
+    string name;
+    vector<string> cells;
+  };
+  vector<row> rows;
+
+  cout << "structure, n, capacity, seconds" << endl;
+  for (auto& structure : structures) {
+    for (size_t l = 0; l < max<size_t>(loads.size(), 1); ++l) {
+      row current{structure, {}};
+      if (!loads.empty()) {
+        ostringstream name;
+        name << structure << "@" << loads[l];
+        current.name = name.str();
+      }
+      for (unsigned n : sizes) {
+        size_t capacity = loads.empty() ? n : max<size_t>(1, size_t(n / loads[l] + 0.5));
+        string output, cell = "n/a";
+        vector<string> cell_arguments{structure, to_string(n), "--sweep-cell"};
+        if (!loads.empty()) {
+          ostringstream load;
+          load << loads[l];
+          cell_arguments.insert(cell_arguments.end(), {"--load-factor", load.str()});
+        }
+        cell_arguments.insert(cell_arguments.end(), cell_options.begin(), cell_options.end());
+        if (run_child(program, cell_arguments, timeout, output)) {
+          const string marker = "elapsed time: ";
+          size_t at = output.rfind(marker);
+          double seconds;
+          if (at != string::npos && istringstream(output.substr(at + marker.size())) >> seconds) {
+            ostringstream formatted;
+            formatted << seconds;
+            cell = formatted.str();
+          }
+        }
+        cout << current.name << ", " << n << ", " << capacity << ", " << cell << endl;
+        current.cells.push_back(cell);
+      }
+      rows.push_back(current);
+    }
+  }
+
+  ofstream csv(path);
+  for (unsigned n : sizes) {
+    csv << "," << n;
+  }
+  csv << endl;
+  for (auto& current : rows) {
+    csv << current.name;
+    for (auto& cell : current.cells) {
+      csv << "," << cell;
+    }
+    csv << endl;
+  }
+  if (!csv) {
+    cout << "error: could not write " << path << endl;
+    return 1;
+  }
+  cout << "wrote " << path << endl;
+  return 0;
+}
+
+// Fill a fresh table, sized for n keys at load factor load, with
+// first_half and second_half through set, then find every present and
+// every absent key, timing about one in sample operations of each kind.
+// Sampled operations are chosen at random intervals, so they do not line
+// up with periodic events such as rehashes. Print the latencies as
+// print_latencies does.
+int run_latency(const string& structure, size_t n, double load, unsigned sample,
+                const vector<uint32_t>& first_half,
+                const vector<uint32_t>& second_half,
+                const vector<uint32_t>& absent,
+                const string& csv_path) {
+  auto dict = make_dict(structure, n, load);
+  latency_clock clock;
+  mt19937 gen(SEED);
+  uniform_int_distribution<unsigned> gap(1, 2 * sample - 1);    // mean sample
+
+  vector<uint32_t> present(first_half);
+  present.insert(present.end(), second_half.begin(), second_half.end());
+
+  latency_histogram sets, hits, misses;
+  unsigned countdown = gap(gen);
+  for (auto x : present) {
+    if (--countdown == 0) {
+      uint64_t start = clock.now();
+      dict->set(x, x + 1);
+      sets.record(clock.now() - start);
+      countdown = gap(gen);
+    } else {
+      dict->set(x, x + 1);
+    }
+  }
+
+  size_t wrong = 0;
+  auto time_finds = [&](const vector<uint32_t>& keys, bool expected, latency_histogram& histogram) {
+    for (auto x : keys) {
+      const uint32_t* value;
+      if (--countdown == 0) {
+        uint64_t start = clock.now();
+        value = dict->find(x);
+        histogram.record(clock.now() - start);
+        countdown = gap(gen);
+      } else {
+        value = dict->find(x);
+      }
+      wrong += expected ? (value == nullptr || *value != x + 1) : (value != nullptr);
+    }
+  };
+  time_finds(present, true, hits);
+  time_finds(absent, false, misses);
+  if (wrong != 0) {
+    cout << "error: " << wrong << " lookups gave wrong results" << endl;
+    return 1;
+  }
+
+  return print_latencies(structure, sample, clock.ns_per_tick(),
+                         {{"set", &sets}, {"find hit", &hits}, {"find miss", &misses}},
+                         csv_path);
+}
+
+int main(int argc, char* argv[]) {
+
+  // parse commandline arguments
+
+  vector<string> arguments(argv, argv + argc);
+
+  if (arguments.size() >= 2 && arguments[1] == "--sweep") {
+    vector<string> structures{"naive", "chain", "lp", "cuckoo"};
+    vector<unsigned> sizes{100, 500, 1000, 2000, 5000, 10000, 50000, 100000};
+    vector<double> loads;
+    double timeout = 10;
+    string path = "Dictionary Data Structure times.csv";
+    vector<string> cell_options;
+    for (size_t i = 2; i < arguments.size(); ++i) {
+      if (i + 1 == arguments.size()) {
+        print_usage();
+        return 1;
+      }
+      const string& option = arguments[i];
+      const string& value = arguments[++i];
+      try {
+        if (option == "--structures") {
+          structures = split_list(value);
+        } else if (option == "--sizes") {
+          sizes.clear();
+          for (auto& item : split_list(value)) {
+            int parsed{stoi(item)};
+            if (parsed <= 0) {
+              cout << "error: input size " << parsed << " must be positive" << endl;
+              return 1;
+            }
+            sizes.push_back(parsed);
+          }
+        } else if (option == "--load-factors") {
+          loads.clear();
+          for (auto& item : split_list(value)) {
+            double parsed{stod(item)};
+            if (parsed <= 0) {
+              cout << "error: load factor " << parsed << " must be positive" << endl;
+              return 1;
+            }
+            loads.push_back(parsed);
+          }
+        } else if (option == "--timeout") {
+          timeout = stod(value);
+          if (timeout <= 0) {
+            cout << "error: timeout " << timeout << " must be positive" << endl;
+            return 1;
+          }
+        } else if (option == "--output") {
+          path = value;
+        } else if (option == "--keys") {
+          cell_options.insert(cell_options.end(), {option, value});
+        } else if (option == "--warmup" || option == "--repetitions") {
+          if (stoi(value) < 0) {
+            cout << "error: " << option << " " << value << " must not be negative" << endl;
+            return 1;
+          }
+          cell_options.insert(cell_options.end(), {option, value});
+        } else {
+          print_usage();
+          return 1;
+        }
+      } catch (std::logic_error& e) {
+        cout << "error: '" << value << "' is not a number" << endl;
+        return 1;
+      }
+    }
+    for (auto& structure : structures) {
+      if (!make_dict(structure, 1)) {
+        cout << "error: " << structure << " is not a single-threaded structure" << endl;
+        return 1;
+      }
+    }
+    if (structures.empty() || sizes.empty()) {
+      print_usage();
+      return 1;
+    }
+    return run_sweep(arguments[0], structures, sizes, loads, timeout, path, cell_options);
+  }
+
+  if (arguments.size() < 3) {
+    print_usage();
+    return 1;
+  }
+
+  auto& structure = arguments[1],
+        n_string = arguments[2];
+
+  unsigned n;
+  try {
+    int parsed{stoi(n_string)};
+    if (parsed <= 0) {
+      cout << "error: input size " << parsed << " must be positive" << endl;
+      return 1;
+    }
+    n = parsed;
+  } catch (std::invalid_argument e) {
+    cout << "error: '" << n_string << "' is not an integer" << endl;
+    return 1;
+  }
+  assert(n > 0);
+
+  bool load_sweep = false,
+       readers = false,
+       batch_insert = false,
+       parallel_build = false,
+       bulk_build = false,
+       small_maps = false,
+       count_events = false,
+       sweep_cell = false;
+  unsigned threads = 0;                 // 0: no timed multi-threaded run
+  double load = 1;                      // load factor the table is sized for
+  bool load_given = false;              // whether --load-factor set it
+  unsigned warmup = 0,                  // untimed runs of the phases
+           repetitions = 1,             // timed runs of the phases
+           latency = 0;                 // 0: no latency histograms, else the sampling period
+  string latency_csv;
+  key_order order = key_order::uniform;
+  double stride = 64;                   // for strided keys
+  bool ycsb = false;
+  ycsb_mix mix = ycsb_workload('A');
+  string distribution;                  // empty: the workload's own pattern
+  size_t operations = 0;                // 0: N operations
+  double read_ratio = 0.9,
+         duration = 1.0;
+  for (size_t i = 3; i < arguments.size(); ++i) {
+    bool has_value = (i + 1 < arguments.size());
+    try {
+      if (arguments[i] == "--threads" && has_value) {
+        int parsed{stoi(arguments[++i])};
+        if (parsed <= 0) {
+          cout << "error: thread count " << parsed << " must be positive" << endl;
+          return 1;
+        }
+        threads = parsed;
+        continue;
+      } else if (arguments[i] == "--load-factor" && has_value) {
+        load = stod(arguments[++i]);
+        if (!(load > 0)) {
+          cout << "error: load factor " << load << " must be positive" << endl;
+          return 1;
+        }
+        load_given = true;
+        continue;
+      } else if (arguments[i] == "--warmup" && has_value) {
+        int parsed{stoi(arguments[++i])};
+        if (parsed < 0) {
+          cout << "error: warmup count " << parsed << " must not be negative" << endl;
+          return 1;
+        }
+        warmup = parsed;
+        continue;
+      } else if (arguments[i] == "--repetitions" && has_value) {
+        int parsed{stoi(arguments[++i])};
+        if (parsed <= 0) {
+          cout << "error: repetition count " << parsed << " must be positive" << endl;
+          return 1;
+        }
+        repetitions = parsed;
+        continue;
+      } else if (arguments[i] == "--latency" && has_value) {
+        int parsed{stoi(arguments[++i])};
+        if (parsed <= 0) {
+          cout << "error: sampling period " << parsed << " must be positive" << endl;
+          return 1;
+        }
+        latency = parsed;
+        continue;
+      } else if (arguments[i] == "--latency-csv" && has_value) {
+        latency_csv = arguments[++i];
+        continue;
+      } else if (arguments[i] == "--keys" && has_value) {
+        string name;
+        if (!parse_option_value(arguments[++i], name, stride) || stride < 1 || stride > 0xFFFFFFFFu) {
+          cout << "error: '" << arguments[i] << "' is not a valid key order" << endl;
+          return 1;
+        }
+        if (name == "uniform") {
+          order = key_order::uniform;
+        } else if (name == "sequential") {
+          order = key_order::sequential;
+        } else if (name == "strided") {
+          order = key_order::strided;
+        } else if (name == "adversarial") {
+          order = key_order::adversarial;
+        } else {
+          print_usage();
+          return 1;
+        }
+        continue;
+      } else if (arguments[i] == "--ycsb" && has_value) {
+        const string& name = arguments[++i];
+        try {
+          mix = ycsb_workload(name.size() == 1 ? name[0] : '?');
+        } catch (std::invalid_argument& e) {
+          cout << "error: YCSB workload '" << name << "' must be one of A to F" << endl;
+          return 1;
+        }
+        ycsb = true;
+        continue;
+      } else if (arguments[i] == "--distribution" && has_value) {
+        distribution = arguments[++i];
+        continue;
+      } else if (arguments[i] == "--operations" && has_value) {
+        int parsed{stoi(arguments[++i])};
+        if (parsed <= 0) {
+          cout << "error: operation count " << parsed << " must be positive" << endl;
+          return 1;
+        }
+        operations = parsed;
+        continue;
+      } else if (arguments[i] == "--read-ratio" && has_value) {
+        read_ratio = stod(arguments[++i]);
+        if (read_ratio < 0 || read_ratio > 1) {
+          cout << "error: read ratio " << read_ratio << " must be between 0 and 1" << endl;
+          return 1;
+        }
+        continue;
+      } else if (arguments[i] == "--duration" && has_value) {
+        duration = stod(arguments[++i]);
+        if (duration <= 0) {
+          cout << "error: duration " << duration << " must be positive" << endl;
+          return 1;
+        }
+        continue;
+      }
+    } catch (std::logic_error& e) {
+      cout << "error: '" << arguments[i] << "' is not a number" << endl;
+      return 1;
+    }
+    if (arguments[i] == "--load-sweep") {
+      load_sweep = true;
+    } else if (arguments[i] == "--readers") {
+      readers = true;
+    } else if (arguments[i] == "--batch-insert") {
+      batch_insert = true;
+    } else if (arguments[i] == "--parallel-build") {
+      parallel_build = true;
+    } else if (arguments[i] == "--bulk-build") {
+      bulk_build = true;
+    } else if (arguments[i] == "--small-maps") {
+      small_maps = true;
+    } else if (arguments[i] == "--counters") {
+      count_events = true;
+    } else if (arguments[i] == "--sweep-cell") {
+      sweep_cell = true;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  // each of these modes ends the run, so at most one may be given; --ycsb
+  // with --latency samples the latency of its own requests
+  vector<string> modes;
+  for (auto& mode : {make_pair(load_sweep, "--load-sweep"), make_pair(small_maps, "--small-maps"),
+                     make_pair(parallel_build, "--parallel-build"), make_pair(bulk_build, "--bulk-build"),
+                     make_pair(threads > 0, "--threads"),
+                     make_pair(readers, "--readers"), make_pair(ycsb, "--ycsb"),
+                     make_pair(latency > 0 && !ycsb, "--latency"), make_pair(sweep_cell, "--sweep-cell")}) {
+    if (mode.first) {
+      modes.push_back(mode.second);
+    }
+  }
+  if (modes.size() > 1) {
+    cout << "error: " << modes[0] << " and " << modes[1] << " cannot be combined" << endl;
+    return 1;
+  }
+  if ((batch_insert || count_events) && (load_sweep || small_maps || parallel_build || bulk_build)) {
+    cout << "error: --batch-insert and --counters only apply to the insert and search phases" << endl;
+    return 1;
+  }
+
+  if (load_sweep) {
+    if (structure != "lp_simd") {
+      cout << "error: --load-sweep only applies to lp_simd" << endl;
+      return 1;
+    }
+    return run_load_sweep(n);
+  }
+  if (small_maps) {
+    if (structure != "small_map") {
+      cout << "error: --small-maps only applies to small_map" << endl;
+      return 1;
+    }
+    return run_small_maps(n);
+  }
+  if (parallel_build && structure != "chain" && structure != "lp") {
+    cout << "error: --parallel-build only applies to chain and lp" << endl;
+    return 1;
+  }
+  if (bulk_build && structure != "chain" && structure != "lp" && structure != "cuckoo" &&
+      structure != "sorted" && structure != "eytzinger") {
+    cout << "error: --bulk-build only applies to chain, lp, cuckoo, sorted and eytzinger" << endl;
+    return 1;
+  }
+
+  const bool concurrent = (make_concurrent_dict(structure, 1) != nullptr),
+             snapshot = (structure == "snapshot_lp" || structure == "snapshot_chain");
+  unique_ptr<abstract_dict<uint32_t>> dict;
+  if (concurrent || snapshot) {
+    // built per thread count by run_mixed_scaling and friends
+  } else if (!(dict = make_dict(structure, n, load))) {
+    print_usage();
+    return 1;
+  }
+  assert(dict || concurrent || snapshot);
+
+  if (sweep_cell && !dict) {
+    cout << "error: --sweep-cell only applies to single-threaded structures" << endl;
+    return 1;
+  }
+  if (load != 1 && !dict) {
+    cout << "error: --load-factor only applies to single-threaded structures" << endl;
+    return 1;
+  }
+  // adversarial keys collide only in tables of the size they were chosen for
+  if (order == key_order::adversarial && !dict) {
+    cout << "error: --keys adversarial only applies to single-threaded structures" << endl;
+    return 1;
+  }
+  if (order == key_order::adversarial && structure == "cuckoo") {
+    cout << "error: --keys adversarial does not apply to cuckoo, whose insert does not "
+         << "bound its eviction loop" << endl;
+    return 1;
+  }
+  if (order == key_order::adversarial && (parallel_build || bulk_build || ycsb)) {
+    cout << "error: --keys adversarial cannot be combined with --parallel-build, "
+         << "--bulk-build or --ycsb, which size their own tables" << endl;
+    return 1;
+  }
+  if (!distribution.empty()) {
+    string name;
+    double parameter = (distribution.compare(0, 7, "hotspot") == 0) ? 0.2 : 0.99;
+    if (!parse_option_value(distribution, name, parameter)) {
+      cout << "error: '" << distribution << "' is not a valid distribution" << endl;
+      return 1;
+    }
+    if (name == "uniform") {
+      mix.pattern = access_pattern::uniform;
+    } else if (name == "zipf") {
+      mix.pattern = access_pattern::zipf;
+    } else if (name == "hotspot") {
+      mix.pattern = access_pattern::hotspot;
+    } else if (name == "latest") {
+      mix.pattern = access_pattern::latest;
+    } else {
+      print_usage();
+      return 1;
+    }
+    mix.parameter = parameter;
+    try {
+      record_chooser(mix.pattern, mix.parameter, 1);
+    } catch (std::invalid_argument& e) {
+      cout << "error: " << distribution << ": " << e.what() << endl;
+      return 1;
+    }
+  }
+  if ((ycsb || !distribution.empty() || operations) && !dict) {
+    cout << "error: --ycsb only applies to single-threaded structures" << endl;
+    return 1;
+  }
+  if ((!distribution.empty() || operations) && !ycsb) {
+    cout << "error: --distribution and --operations need --ycsb" << endl;
+    return 1;
+  }
+  if (latency && !dict) {
+    cout << "error: --latency only applies to single-threaded structures" << endl;
+    return 1;
+  }
+  if (!latency_csv.empty() && !latency) {
+    cout << "error: --latency-csv needs --latency" << endl;
+    return 1;
+  }
+  if (threads > 0 && !concurrent) {
+    cout << "error: --threads only applies to concurrent structures" << endl;
+    return 1;
+  }
+  if ((batch_insert || count_events) && !dict) {
+    cout << "error: --batch-insert and --counters only apply to single-threaded structures" << endl;
+    return 1;
+  }
+
+  // print parameters
+  cout << "== dictionary benchmark ==" << endl
+       << "structure: " << structure << endl
+       << "n: " << n << endl;
+
+
+  cout << "generating input..." << flush;
+  vector<uint32_t> first_half,   // n/2 elements to insert
+                   second_half,  // remaining n/2 elements to insert
+                   absent; // n/2 elements to search for, that were never inserted
+  generate_input(n, first_half, second_half, absent, order, uint64_t(stride), dict.get());
+
+  if (concurrent) {
+    vector<uint32_t> keys(first_half);
+    keys.insert(keys.end(), second_half.begin(), second_half.end());
+    if (threads > 0) {
+      cout << endl << threads << " threads, read ratio " << read_ratio
+           << ", for " << duration << " seconds:" << endl;
+      return run_timed_mix(structure, n, threads, read_ratio, duration, first_half, keys);
+    }
+    if (readers) {
+      cout << endl << "lookups on a shared table during writes:" << endl;
+      return run_readers_under_writes(structure, n, first_half, second_half);
+    }
+    cout << endl << "mixed workload on a shared table:" << endl;
+    return run_mixed_scaling(structure, n, first_half, keys);
+  }
+  if (snapshot) {
+    cout << endl << "lookups on a snapshot table while new tables are published:" << endl;
+    if (structure == "snapshot_chain") {
+      return run_snapshot_readers<chain_dict<uint32_t>>(first_half, second_half, absent);
+    }
+    return run_snapshot_readers<lp_dict<uint32_t>>(first_half, second_half, absent);
+  }
+  if (parallel_build) {
+    vector<uint32_t> keys(first_half);
+    keys.insert(keys.end(), second_half.begin(), second_half.end());
+    cout << endl << "parallel bulk build:" << endl;
+    if (structure == "chain") {
+      return run_build_scaling<chain_dict<uint32_t>>(keys, absent);
+    }
+    return run_build_scaling<lp_dict<uint32_t>>(keys, absent);
+  }
+  if (bulk_build) {
+    vector<uint32_t> keys(first_half);
+    keys.insert(keys.end(), second_half.begin(), second_half.end());
+    cout << endl << "bulk build against set:" << endl;
+    // unless --load-factor says otherwise, set fills its table as full as
+    // build_from does: lp_dict builds at BUILD_LOAD, the others at one
+    // slot per key
+    if (structure == "chain") {
+      return run_bulk_build<chain_dict<uint32_t>>(structure, load, keys, absent);
+    } else if (structure == "lp") {
+      return run_bulk_build<lp_dict<uint32_t>>(structure, load_given ? load : lp_dict<uint32_t>::BUILD_LOAD,
+                                               keys, absent);
+    } else if (structure == "cuckoo") {
+      return run_bulk_build<cuckoo_dict<uint32_t>>(structure, load, keys, absent);
+    } else if (structure == "sorted") {
+      return run_bulk_build<sorted_dict<uint32_t>>(structure, load, keys, absent);
+    }
+    return run_bulk_build<sorted_dict<uint32_t, eytzinger_layout>>(structure, load, keys, absent);
+  }
+
+  cout << endl << "inserting " << (batch_insert ? "(in batches) " : "")
+       << "and searching for " << n << " elements..." << endl;
+
+  // warmup runs, then measured runs, each on a fresh table from the same
+  // input; the last table is kept for the benchmarks below
+  using clock = chrono::high_resolution_clock;
+  unique_ptr<perf_counters> counters;
+  if (count_events) {
+    counters.reset(new perf_counters());
+    if (!counters->any_available()) {
+      cout << "hardware counters unavailable (" << counters->error() << "), timing only" << endl;
+      counters.reset();
+    }
+  }
+  vector<vector<phase_time>> runs;
+  for (unsigned run = 0; run < warmup + repetitions; ++run) {
+    if (run > 0) {
+      dict = make_dict(structure, n, load);
+    }
+    vector<phase_time> phases;
+    if (run_phases(*dict, first_half, second_half, absent, batch_insert, phases, counters.get()) != 0) {
+      return 1;
+    }
+    if (run >= warmup) {
+      runs.push_back(phases);
+    }
+  }
+  if (runs.size() == 1) {
+    print_phases(runs[0]);
+  } else {
+    print_phase_stats(runs);
+  }
+  if (counters) {
+    print_phase_counters(runs);
+  }
+  if (sweep_cell) {
+    return 0;
+  }
+
+  // print probe lengths, for structures that track them
+  print_probe_lengths<lp_dict<uint32_t>>(dict.get());
+  print_probe_lengths<lp_dict<uint32_t, quadratic_probe>>(dict.get());
+  print_probe_lengths<lp_dict<uint32_t, double_hash_probe>>(dict.get());
+  print_probe_lengths<robin_hood_dict<uint32_t>>(dict.get());
+
+  vector<uint32_t> present(first_half);
+  present.insert(present.end(), second_half.begin(), second_half.end());
+
+  // time ordered range scans, for structures that keep keys in order
+  if (print_range_scans<sorted_dict<uint32_t>>(dict.get(), present) != 0 ||
+      print_range_scans<sorted_dict<uint32_t, eytzinger_layout>>(dict.get(), present) != 0) {
+    return 1;
+  }
+
+  if (ycsb) {
+    try {
+      return run_ycsb(structure, load_given ? load : YCSB_LOAD, mix, mix.pattern, mix.parameter,
+                      present, absent, operations ? operations : n, latency, latency_csv);
+    } catch (std::length_error& e) {
+      cout << "error: " << e.what() << endl;
+      return 1;
+    }
+  }
+
+  if (latency) {
+    return run_latency(structure, n, load, latency,
+                       first_half, second_half, absent, latency_csv);
+  }
+
+  if (readers) {
+    cout << "read-only lookups from concurrent threads:" << endl;
+    const abstract_dict<uint32_t>& shared = *dict;
+    return run_reader_scaling(shared, present, absent);
+  }
+
+  // batched lookups: look up every present key, first one search() at a
+  // time and then through search_batch(), which overlaps cache misses
+  cout << "looking up " << n << " elements one at a time and in batches..." << flush;
+  vector<uint32_t*> found(present.size());
+
+  uint64_t checksum = 0;
+  auto single_start = clock::now();
+  for (auto x : present) {
+    checksum += dict->search(x);
+  }
+  auto single_end = clock::now();
+
+  auto batch_start = clock::now();
+  dict->search_batch(present.data(), found.data(), present.size());
+  auto batch_end = clock::now();
+
+  for (size_t i = 0; i < present.size(); ++i) {
+    if (found[i] == nullptr || *found[i] != present[i] + 1) {
+      cout << "error: search_batch missed " << present[i] << endl;
+      return 1;
+    }
+  }
+  found.resize(absent.size());
+  dict->search_batch(absent.data(), found.data(), absent.size());
+  for (size_t i = 0; i < absent.size(); ++i) {
+    if (found[i] != nullptr) {
+      cout << "error: search_batch found absent key " << absent[i] << endl;
+      return 1;
+    }
+  }
+
+  double single_seconds = chrono::duration_cast<chrono::duration<double>>(single_end - single_start).count(),
+         batch_seconds = chrono::duration_cast<chrono::duration<double>>(batch_end - batch_start).count();
+  cout << endl << "single lookup time: " << single_seconds << " seconds (checksum " << checksum << ")" << endl
+       << "batch lookup time: " << batch_seconds << " seconds" << endl
+       << "batch speedup: " << single_seconds / batch_seconds << endl;
+
+  // churn: keep n/2 keys live while repeatedly erasing the oldest live key
+  // and inserting a key that is not live. The 1.5n distinct keys form a
+  // ring, and the live keys are a window of n/2 consecutive ring positions
+  // that slides forward one position per erase+insert pair. The second
+  // half is erased first, so churn runs at half the load the table was
+  // filled to and is never full, even at --load-factor 1.
+  cout << "churning " << n << " erase+insert pairs at " << first_half.size()
+       << " live elements..." << flush;
+
+  for (auto x : second_half) {
+    if (!dict->erase(x)) {
+      cout << "error: erase(" << x << ") failed" << endl;
+      return 1;
+    }
+  }
+  if (check_all_present(*dict, first_half)) {
+    return 1;
+  }
+  if (check_all_absent(*dict, second_half)) {
+    return 1;
+  }
+
+  vector<uint32_t> ring(first_half);
+  ring.insert(ring.end(), second_half.begin(), second_half.end());
+  ring.insert(ring.end(), absent.begin(), absent.end());
+  const size_t live_n = first_half.size();
+
+  auto churn_start = clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t oldest = ring[i % ring.size()],
+             fresh = ring[(i + live_n) % ring.size()];
+    if (!dict->erase(oldest)) {
+      cout << "error: erase(" << oldest << ") failed" << endl;
+      return 1;
+    }
+    dict->set(fresh, fresh + 1);
+  }
+  auto churn_end = clock::now();
+
+  // the window now starts at ring position n
+  vector<uint32_t> live, idle;
+  for (size_t i = 0; i < ring.size(); ++i) {
+    size_t offset = (i + ring.size() - n % ring.size()) % ring.size();
+    (offset < live_n ? live : idle).push_back(ring[i]);
+  }
+  if (check_all_present(*dict, live)) {
+    return 1;
+  }
+  if (check_all_absent(*dict, idle)) {
+    return 1;
+  }
+
+  double churn_seconds = chrono::duration_cast<chrono::duration<double>>(churn_end - churn_start).count();
+  cout << endl << "churn time: " << churn_seconds << " seconds" << endl;
 
   return 0;
 }
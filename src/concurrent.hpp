@@ -0,0 +1,1067 @@
+///////////////////////////////////////////////////////////////////////////////
+// concurrent.hpp
+//
+// Dictionaries that many threads may use at once: a chained hash table
+// sharded under striped reader/writer locks, a lock-free linear probing
+// table, a cuckoo table with optimistic lookups, a read-mostly wrapper
+// that republishes whole tables RCU-style, and a table sharded across
+// server threads that receive requests through lock-free queues.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "hashes.hpp"
+
+namespace hashes {
+
+  // Bytes per cache line. State that different threads write, such as locks
+  // and counters, is padded to this so that neighbours do not share a line.
+  const size_t CACHE_LINE = 64;
+
+  // Pin the calling thread to the given core, where the platform allows it.
+  // Return false if it could not be pinned.
+  inline bool pin_to_core(unsigned core) {
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % 64)) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+  }
+
+  // Waits for another thread with exponential backoff: first a doubling
+  // number of pause instructions, which keep the core to the waiting
+  // thread without flooding the memory system, then yields. With a single
+  // hardware thread the other thread cannot run while this one spins, so
+  // it yields straight away.
+  class backoff {
+  public:
+
+    // Spin rounds before pause() starts yielding; the last spins 2^9 pauses.
+    static constexpr unsigned SPIN_ROUNDS = 10;
+
+    void pause() noexcept {
+      static const unsigned spin_rounds = std::thread::hardware_concurrency() > 1 ? SPIN_ROUNDS : 0;
+      if (round_ < spin_rounds) {
+        for (unsigned i = 0; i < (1u << round_); i++) {
+#if HASHES_HAVE_SSE2
+          _mm_pause();
+#endif
+        }
+        round_++;
+      } else {
+        std::this_thread::yield();
+        yields_++;
+      }
+    }
+
+    // Number of times pause() has yielded since the last reset.
+    unsigned yields() const noexcept { return yields_; }
+
+    void reset() noexcept { round_ = yields_ = 0; }
+
+  private:
+    unsigned round_ = 0, yields_ = 0;
+  };
+
+  // Abstract base class for a dictionary that any number of threads may
+  // use concurrently. Another thread may erase an entry at any time, so
+  // lookups copy the value out instead of returning a reference to it.
+  template <typename T>
+  class abstract_concurrent_dict {
+  public:
+
+    virtual ~abstract_concurrent_dict() { }
+
+    // If key is present, copy its value to out and return true. Otherwise
+    // return false and leave out unchanged.
+    virtual bool find(uint32_t key, T& out) const = 0;
+
+    // Assign key to be associated with val. If key is already in the dictionary,
+    // replace that association.
+    //
+    // Throw std::length_error if the dictionary is too full to add another
+    // entry.
+    virtual void set(uint32_t key, T&& val) = 0;
+
+    // Remove key and its associated value. Return true if key was present,
+    // false if it was absent.
+    virtual bool erase(uint32_t key) = 0;
+
+    // Number of operations so far that found their lock held by another
+    // thread and had to wait, or 0 for structures that do not count this.
+    virtual uint64_t contention() const noexcept { return 0; }
+  };
+
+  // Hash table with chaining, split into stripes that each own a slice of
+  // the buckets and a reader/writer lock. The top bits of a key's hash pick
+  // its stripe and the rest pick the bucket within the stripe, so
+  // operations on different stripes never touch the same lock or bucket.
+  // Lookups share the stripe lock; set and erase take it exclusively. Each
+  // stripe doubles its own buckets when its load factor passes 1, without
+  // stopping the other stripes.
+  template <typename T>
+  class striped_chain_dict : public abstract_concurrent_dict<T> {
+  public:
+
+    // Create an empty dictionary, with the given capacity, split into the
+    // given number of stripes (rounded up to a power of two).
+    striped_chain_dict(size_t capacity, size_t stripes = 64)
+    : stripe_count_(next_power_of_two(stripes)),
+      stripes_(new stripe[stripe_count_]) {
+      stripe_bits_ = 0;
+      while ((size_t(1) << stripe_bits_) < stripe_count_) {
+        stripe_bits_++;
+      }
+      size_t buckets = std::max<size_t>(1, capacity / stripe_count_);
+      for (size_t i = 0; i < stripe_count_; i++) {
+        stripes_[i].buckets.resize(buckets);
+      }
+    }
+
+    virtual bool find(uint32_t key, T& out) const {
+      uint32_t hash = hashfxn.hash(key);
+      stripe& owner = stripe_of(hash);
+      lock_shared(owner);
+      std::shared_lock<std::shared_mutex> guard(owner.lock, std::adopt_lock);
+
+      const auto& chain = owner.buckets[hash % owner.buckets.size()];
+      for (const auto& item : chain) {
+        if (item.key() == key) {
+          out = item.value();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      uint32_t hash = hashfxn.hash(key);
+      stripe& owner = stripe_of(hash);
+      lock(owner);
+      std::unique_lock<std::shared_mutex> guard(owner.lock, std::adopt_lock);
+
+      auto& chain = owner.buckets[hash % owner.buckets.size()];
+      for (auto& item : chain) {
+        if (item.key() == key) {
+          item.set_value(std::move(val));
+          return;
+        }
+      }
+      chain.emplace_back(key, std::move(val));
+      if (++owner.count > owner.buckets.size()) {
+        grow(owner);
+      }
+    }
+
+    virtual bool erase(uint32_t key) {
+      uint32_t hash = hashfxn.hash(key);
+      stripe& owner = stripe_of(hash);
+      lock(owner);
+      std::unique_lock<std::shared_mutex> guard(owner.lock, std::adopt_lock);
+
+      auto& chain = owner.buckets[hash % owner.buckets.size()];
+      for (auto iter = chain.begin(); iter != chain.end(); ++iter) {
+        if (iter->key() == key) {
+          if (iter != chain.end() - 1) {
+            *iter = std::move(chain.back());      // swap-and-pop, as in chain_dict
+          }
+          chain.pop_back();
+          owner.count--;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    virtual uint64_t contention() const noexcept {
+      uint64_t total = 0;
+      for (size_t i = 0; i < stripe_count_; i++) {
+        total += stripes_[i].contended.load(std::memory_order_relaxed);
+      }
+      return total;
+    }
+
+  private:
+    // One lock and its slice of the table, on cache lines of its own.
+    struct alignas(CACHE_LINE) stripe {
+      std::shared_mutex lock;
+      std::atomic<uint64_t> contended{0};         // acquisitions that had to wait
+      std::vector<std::vector<entry<T>>> buckets;
+      size_t count = 0;                           // entries in this stripe
+    };
+
+    size_t stripe_count_;                         // a power of two
+    unsigned stripe_bits_;                        // log2(stripe_count_)
+    std::unique_ptr<stripe[]> stripes_;
+    poly2_hash_func hashfxn;                      // hash function, as chain_dict
+
+    // Polynomial hashes mix best into their high bits, so those pick the stripe.
+    stripe& stripe_of(uint32_t hash) const noexcept {
+      return stripes_[stripe_bits_ == 0 ? 0 : hash >> (32 - stripe_bits_)];
+    }
+
+    // Take owner's lock exclusively, counting the acquisition if it had to wait.
+    void lock(stripe& owner) const {
+      if (!owner.lock.try_lock()) {
+        owner.contended.fetch_add(1, std::memory_order_relaxed);
+        owner.lock.lock();
+      }
+    }
+
+    // Take owner's lock shared, counting the acquisition if it had to wait.
+    void lock_shared(stripe& owner) const {
+      if (!owner.lock.try_lock_shared()) {
+        owner.contended.fetch_add(1, std::memory_order_relaxed);
+        owner.lock.lock_shared();
+      }
+    }
+
+    // Double owner's buckets. Its lock must be held exclusively.
+    void grow(stripe& owner) {
+      std::vector<std::vector<entry<T>>> old_buckets(owner.buckets.size() * 2);
+      old_buckets.swap(owner.buckets);
+      for (auto& chain : old_buckets) {
+        for (auto& item : chain) {
+          uint32_t hash = hashfxn.hash(item.key());
+          owner.buckets[hash % owner.buckets.size()].push_back(std::move(item));
+        }
+      }
+    }
+  };
+
+  // Linear probing, as lp_dict, but lock-free. Each slot is one 64-bit
+  // atomic word holding a key in its high half and a value in its low half,
+  // so a slot changes all at once and a reader never sees a key without its
+  // value. A writer claims an empty slot for its key with compare_exchange;
+  // once claimed, a slot keeps that key for the life of the table, so later
+  // sets and erases only rewrite the value half, with release stores.
+  // Erasing stores ABSENT_VALUE instead of emptying the slot, and setting
+  // the key again reuses the slot. Readers never write and never retry, so
+  // a lookup is wait-free: at most one pass over the table.
+  //
+  // T must be trivially copyable and at most 4 bytes. A value is stored in
+  // the low bytes of its 32-bit half, with the rest zero, so only a 4-byte
+  // value can have the reserved ABSENT_VALUE bits. The capacity is fixed:
+  // set throws std::length_error once every slot holds some key, erased or
+  // not.
+  template <typename T>
+  class lockfree_lp_dict : public abstract_concurrent_dict<T> {
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(uint32_t),
+                  "lockfree_lp_dict values must pack into 32 bits");
+  public:
+
+    // Key marking an empty slot. It is kept outside the table.
+    static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+
+    // Value bits marking an erased key. No value may have these bits.
+    static constexpr uint32_t ABSENT_VALUE = 0xFFFFFFFF;
+
+    // Create an empty dictionary with room for capacity distinct keys, in a
+    // table of at least twice that many slots.
+    lockfree_lp_dict(size_t capacity)
+    : size_(next_power_of_two(std::max<size_t>(2 * capacity, 2))),
+      slots_(new std::atomic<uint64_t>[size_]),
+      empty_key_value_(ABSENT_VALUE) {
+      for (size_t i = 0; i < size_; i++) {
+        slots_[i].store(pack(EMPTY_KEY, ABSENT_VALUE), std::memory_order_relaxed);
+      }
+    }
+
+    virtual bool find(uint32_t key, T& out) const {
+      uint32_t bits;
+      if (key == EMPTY_KEY) {
+        bits = empty_key_value_.load(std::memory_order_acquire);
+      } else {
+        size_t index = find_slot(key);
+        if (index == size_) {
+          return false;
+        }
+        bits = uint32_t(slots_[index].load(std::memory_order_acquire));
+      }
+      if (bits == ABSENT_VALUE) {
+        return false;
+      }
+      std::memcpy(&out, &bits, sizeof(T));
+      return true;
+    }
+
+    // Throw std::invalid_argument if val has the reserved ABSENT_VALUE bits.
+    virtual void set(uint32_t key, T&& val) {
+      uint32_t bits = 0;                                // padding bytes stay zero
+      std::memcpy(&bits, &val, sizeof(T));
+      if (bits == ABSENT_VALUE) {
+        throw std::invalid_argument("value reserved in lockfree_lp_dict::set");
+      }
+      if (key == EMPTY_KEY) {
+        empty_key_value_.store(bits, std::memory_order_release);
+        return;
+      }
+
+      size_t mask = size_ - 1;
+      size_t index = mix_bits(hashfxn.hash(key)) & mask;
+      for (size_t attempt = 0; attempt < size_; attempt++, index = (index + 1) & mask) {
+        uint64_t word = slots_[index].load(std::memory_order_acquire);
+        if (key_of(word) == EMPTY_KEY) {
+          // try to claim the slot; on failure word holds the winner's claim
+          if (slots_[index].compare_exchange_strong(word, pack(key, bits),
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_acquire)) {
+            return;
+          }
+          failed_claims_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (key_of(word) == key) {
+          slots_[index].store(pack(key, bits), std::memory_order_release);
+          return;
+        }
+      }
+      throw std::length_error("lockfree_lp_dict is full");
+    }
+
+    virtual bool erase(uint32_t key) {
+      if (key == EMPTY_KEY) {
+        return empty_key_value_.exchange(ABSENT_VALUE, std::memory_order_acq_rel) != ABSENT_VALUE;
+      }
+      size_t index = find_slot(key);
+      if (index == size_) {
+        return false;
+      }
+      uint64_t old = slots_[index].exchange(pack(key, ABSENT_VALUE), std::memory_order_acq_rel);
+      return uint32_t(old) != ABSENT_VALUE;
+    }
+
+    // Number of slot claims lost to another thread claiming the same slot.
+    virtual uint64_t contention() const noexcept {
+      return failed_claims_.load(std::memory_order_relaxed);
+    }
+
+    // Number of slots in the table.
+    size_t table_size() const noexcept { return size_; }
+
+  private:
+    size_t size_;                                       // a power of two
+    std::unique_ptr<std::atomic<uint64_t>[]> slots_;    // key << 32 | value bits
+    std::atomic<uint32_t> empty_key_value_;             // value bits of EMPTY_KEY itself
+    alignas(CACHE_LINE) std::atomic<uint64_t> failed_claims_{0};
+    poly5_hash_func hashfxn;                            // hash function, as lp_dict
+
+    static uint64_t pack(uint32_t key, uint32_t bits) noexcept {
+      return (uint64_t(key) << 32) | bits;
+    }
+
+    static uint32_t key_of(uint64_t word) noexcept {
+      return uint32_t(word >> 32);
+    }
+
+    // Return the index of the slot claimed by key, or size_ if key has never
+    // been set. Slots are never released, so the first empty slot ends the
+    // search.
+    size_t find_slot(uint32_t key) const noexcept {
+      size_t mask = size_ - 1;
+      size_t index = mix_bits(hashfxn.hash(key)) & mask;
+      for (size_t attempt = 0; attempt < size_; attempt++, index = (index + 1) & mask) {
+        uint32_t slot_key = key_of(slots_[index].load(std::memory_order_acquire));
+        if (slot_key == key) {
+          return index;
+        }
+        if (slot_key == EMPTY_KEY) {
+          break;
+        }
+      }
+      return size_;
+    }
+  };
+
+  // Cuckoo hashing, as cuckoo_dict, made safe for concurrent use in the
+  // style of libcuckoo. The table is an array of buckets of SLOTS slots, and
+  // each key may live in either of two buckets chosen by two tabular hashes.
+  //
+  // Every bucket has a version counter that doubles as its lock: a writer
+  // makes it odd while changing the bucket and even again when done. Writers
+  // only ever lock the two buckets they are working on, in index order. A
+  // lookup takes no lock: it reads the versions of the key's two buckets,
+  // reads both buckets, and retries if either version was odd or has
+  // changed since, so it costs two bucket reads unless a writer interferes.
+  //
+  // When both of a key's buckets are full, set searches breadth-first,
+  // without locks, for the shortest path of evictions that ends in a free
+  // slot, then carries it out from the free end backwards, one move at a
+  // time under the locks of that move's two buckets. A key is copied to its
+  // new bucket before it leaves its old one, and both buckets change under
+  // one pair of version bumps, so a lookup never misses a key in transit.
+  // If another writer changed the path meanwhile, set searches again.
+  //
+  // T must be trivially copyable. The capacity is fixed: set throws
+  // std::length_error when no eviction path to a free slot can be found.
+  template <typename T>
+  class concurrent_cuckoo_dict : public abstract_concurrent_dict<T> {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "concurrent_cuckoo_dict values must be trivially copyable");
+  public:
+
+    // Slots per bucket.
+    static constexpr unsigned SLOTS = 4;
+
+    // Most buckets that one eviction path search may visit.
+    static constexpr size_t MAX_SEARCH = 512;
+
+    // Create an empty dictionary with room for capacity keys, at a load
+    // factor of at most 0.8.
+    concurrent_cuckoo_dict(size_t capacity)
+    : bucket_count_(next_power_of_two(std::max<size_t>((capacity + capacity / 4) / SLOTS, 1))),
+      buckets_(new bucket[bucket_count_]),
+      hashfxn(2) { }
+
+    virtual bool find(uint32_t key, T& out) const {
+      size_t b1, b2;
+      buckets_of(key, b1, b2);
+      const bucket& first = buckets_[b1];
+      const bucket& second = buckets_[b2];
+      for (;;) {
+        uint32_t v1 = first.version.load(std::memory_order_acquire),
+                 v2 = second.version.load(std::memory_order_acquire);
+        if (((v1 | v2) & 1) == 0) {
+          T value;
+          bool found = read(first, key, value) || read(second, key, value);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (first.version.load(std::memory_order_relaxed) == v1 &&
+              second.version.load(std::memory_order_relaxed) == v2) {
+            if (found) {
+              out = value;
+            }
+            return found;
+          }
+        } else {
+          std::this_thread::yield();            // a writer holds one of them
+        }
+        read_retries_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      size_t b1, b2;
+      buckets_of(key, b1, b2);
+      for (;;) {
+        lock_pair(b1, b2);
+        bool done = assign(buckets_[b1], key, val) || assign(buckets_[b2], key, val) ||
+                    place(buckets_[b1], key, val) || place(buckets_[b2], key, val);
+        unlock_pair(b1, b2);
+        if (done) {
+          return;
+        }
+
+        std::vector<step> path;
+        if (!find_path(b1, b2, path)) {
+          throw std::length_error("concurrent_cuckoo_dict is full");
+        }
+        move_along(path);                       // frees a slot in b1 or b2, unless raced
+      }
+    }
+
+    virtual bool erase(uint32_t key) {
+      size_t b1, b2;
+      buckets_of(key, b1, b2);
+      lock_pair(b1, b2);
+      bool erased = remove(buckets_[b1], key) || remove(buckets_[b2], key);
+      unlock_pair(b1, b2);
+      return erased;
+    }
+
+    // Number of writer lock acquisitions that had to wait, plus lookups
+    // retried because a writer changed one of their buckets.
+    virtual uint64_t contention() const noexcept {
+      return lock_waits_.load(std::memory_order_relaxed) + read_retries();
+    }
+
+    // Number of lookups retried because a writer changed one of their buckets.
+    uint64_t read_retries() const noexcept {
+      return read_retries_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // SLOTS keys and values, a bit per slot saying which hold an entry, and
+    // the version/lock word.
+    struct bucket {
+      std::atomic<uint32_t> version{0};           // odd while a writer holds it
+      std::atomic<uint32_t> occupied{0};          // bit i set if slot i is in use
+      std::atomic<uint32_t> keys[SLOTS]{};
+      std::atomic<T> values[SLOTS]{};
+    };
+
+    // One node of the eviction path search: the key in slot of parent's
+    // bucket could move to this bucket.
+    struct step {
+      size_t bucket;
+      int parent;                                 // index of the parent step, -1 at the roots
+      unsigned slot;
+      uint32_t key;
+    };
+
+    size_t bucket_count_;                         // a power of two
+    std::unique_ptr<bucket[]> buckets_;
+    std::vector<tabular_hash_func> hashfxn;       // hash functions, as cuckoo_dict
+    alignas(CACHE_LINE) mutable std::atomic<uint64_t> lock_waits_{0};
+    alignas(CACHE_LINE) mutable std::atomic<uint64_t> read_retries_{0};
+
+    void buckets_of(uint32_t key, size_t& b1, size_t& b2) const noexcept {
+      b1 = mix_bits(hashfxn[0].hash(key)) & (bucket_count_ - 1);
+      b2 = mix_bits(hashfxn[1].hash(key)) & (bucket_count_ - 1);
+    }
+
+    // The bucket other than b that key may live in, or b if its two buckets
+    // are the same.
+    size_t other_bucket(uint32_t key, size_t b) const noexcept {
+      size_t b1, b2;
+      buckets_of(key, b1, b2);
+      return b == b1 ? b2 : b1;
+    }
+
+    static bool read(const bucket& b, uint32_t key, T& out) noexcept {
+      uint32_t occupied = b.occupied.load(std::memory_order_relaxed);
+      for (unsigned i = 0; i < SLOTS; i++) {
+        if ((occupied >> i & 1) && b.keys[i].load(std::memory_order_relaxed) == key) {
+          out = b.values[i].load(std::memory_order_relaxed);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // The slot of b holding key, or SLOTS if none. b must be locked.
+    static unsigned slot_of(const bucket& b, uint32_t key) noexcept {
+      uint32_t occupied = b.occupied.load(std::memory_order_relaxed);
+      for (unsigned i = 0; i < SLOTS; i++) {
+        if ((occupied >> i & 1) && b.keys[i].load(std::memory_order_relaxed) == key) {
+          return i;
+        }
+      }
+      return SLOTS;
+    }
+
+    // Replace key's value if it is in b. b must be locked.
+    static bool assign(bucket& b, uint32_t key, const T& val) noexcept {
+      unsigned i = slot_of(b, key);
+      if (i == SLOTS) {
+        return false;
+      }
+      b.values[i].store(val, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Add key to a free slot of b, if it has one. b must be locked.
+    static bool place(bucket& b, uint32_t key, const T& val) noexcept {
+      uint32_t occupied = b.occupied.load(std::memory_order_relaxed);
+      if (occupied == (1u << SLOTS) - 1) {
+        return false;
+      }
+      unsigned i = lowest_bit(~occupied);
+      b.keys[i].store(key, std::memory_order_relaxed);
+      b.values[i].store(val, std::memory_order_relaxed);
+      b.occupied.store(occupied | 1u << i, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Remove key from b if it is there. b must be locked.
+    static bool remove(bucket& b, uint32_t key) noexcept {
+      unsigned i = slot_of(b, key);
+      if (i == SLOTS) {
+        return false;
+      }
+      b.occupied.store(b.occupied.load(std::memory_order_relaxed) & ~(1u << i),
+                       std::memory_order_relaxed);
+      return true;
+    }
+
+    // Make b's version odd, waiting for any writer holding it.
+    void lock(bucket& b) const {
+      uint32_t version = b.version.load(std::memory_order_relaxed);
+      bool waited = false;
+      while ((version & 1) ||
+             !b.version.compare_exchange_strong(version, version + 1,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+        waited = true;
+        if (version & 1) {
+          std::this_thread::yield();
+          version = b.version.load(std::memory_order_relaxed);
+        }
+      }
+      if (waited) {
+        lock_waits_.fetch_add(1, std::memory_order_relaxed);
+      }
+      // keep the bucket writes that follow from being seen before the odd version
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // Make b's version even again, publishing the writes made under it.
+    static void unlock(bucket& b) noexcept {
+      b.version.store(b.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Lock buckets b1 and b2 in index order, so that two writers never wait
+    // on each other's second lock.
+    void lock_pair(size_t b1, size_t b2) const {
+      lock(buckets_[std::min(b1, b2)]);
+      if (b1 != b2) {
+        lock(buckets_[std::max(b1, b2)]);
+      }
+    }
+
+    void unlock_pair(size_t b1, size_t b2) const noexcept {
+      unlock(buckets_[b1]);
+      if (b1 != b2) {
+        unlock(buckets_[b2]);
+      }
+    }
+
+    // Search breadth-first from buckets b1 and b2 for a bucket with a free
+    // slot, reading without locks. On success, leave in path the search tree
+    // with the free bucket last, and return true.
+    bool find_path(size_t b1, size_t b2, std::vector<step>& path) const {
+      path.clear();
+      path.push_back({b1, -1, 0, 0});
+      if (b2 != b1) {
+        path.push_back({b2, -1, 0, 0});
+      }
+      for (size_t i = 0; i < path.size(); i++) {
+        const bucket& b = buckets_[path[i].bucket];
+        uint32_t occupied = b.occupied.load(std::memory_order_relaxed);
+        if (occupied != (1u << SLOTS) - 1) {
+          path.resize(i + 1);
+          return true;
+        }
+        for (unsigned slot = 0; slot < SLOTS && path.size() < MAX_SEARCH; slot++) {
+          uint32_t key = b.keys[slot].load(std::memory_order_relaxed);
+          size_t next = other_bucket(key, path[i].bucket);
+          if (next != path[i].bucket) {
+            path.push_back({next, int(i), slot, key});
+          }
+        }
+      }
+      return false;
+    }
+
+    // Carry out the evictions leading to the last step of path, starting
+    // from its free end. Return false if another writer got in the way.
+    bool move_along(const std::vector<step>& path) {
+      for (int i = int(path.size()) - 1; path[i].parent >= 0; i = path[i].parent) {
+        const step& to = path[i];
+        size_t from = path[to.parent].bucket;
+        lock_pair(from, to.bucket);
+        bucket& source = buckets_[from];
+        bucket& target = buckets_[to.bucket];
+        bool still_there = (source.occupied.load(std::memory_order_relaxed) >> to.slot & 1) &&
+                           source.keys[to.slot].load(std::memory_order_relaxed) == to.key;
+        bool moved = still_there &&
+                     place(target, to.key, source.values[to.slot].load(std::memory_order_relaxed));
+        if (moved) {
+          source.occupied.store(source.occupied.load(std::memory_order_relaxed) & ~(1u << to.slot),
+                                std::memory_order_relaxed);
+        }
+        unlock_pair(from, to.bucket);
+        if (!moved) {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+
+  // A read-mostly dictionary: a fully built Dict (lp_dict or chain_dict)
+  // that readers share, and that writers replace as a whole rather than
+  // change. A new table is built off to the side, possibly in the
+  // background, and published with one atomic pointer swap, so readers
+  // never see a half-built table, and never take a lock.
+  //
+  // The old table is reclaimed after a grace period, in the style of RCU.
+  // Each reader announces itself in one of READER_SLOTS counters for the
+  // current epoch parity before loading the table pointer, and withdraws
+  // when done. Publishing swaps the pointer, flips the epoch, and waits for
+  // the counters of the old parity to drain; no reader still counted there
+  // can hold the old table after that, so it is deleted. Publishers are
+  // serialized by a mutex, which readers never touch.
+  template <typename T, typename Dict = lp_dict<T>>
+  class snapshot_dict {
+  public:
+
+    // Reader counters, each on its own cache line. Readers pick one by
+    // thread, so that readers on different cores rarely share a line.
+    static constexpr size_t READER_SLOTS = 64;
+
+    // Start with an empty table.
+    snapshot_dict()
+    : current_(Dict::build_from(nullptr, 0).release()),
+      readers_(new reader_slot[READER_SLOTS]) { }
+
+    // Start with a table holding the n given pairs.
+    snapshot_dict(const std::pair<uint32_t, T>* pairs, size_t n)
+    : current_(Dict::build_from(pairs, n).release()),
+      readers_(new reader_slot[READER_SLOTS]) { }
+
+    // Finish any background rebuild first. A destructor cannot throw, so
+    // its error is dropped here; call wait() beforehand to see it.
+    ~snapshot_dict() {
+      if (pending_.valid()) {
+        try {
+          pending_.get();
+        } catch (...) {
+        }
+      }
+      delete current_.load();
+    }
+
+    snapshot_dict(const snapshot_dict&) = delete;
+    snapshot_dict& operator=(const snapshot_dict&) = delete;
+
+    // If key is present in the current table, copy its value to out and
+    // return true. Otherwise return false and leave out unchanged.
+    bool find(uint32_t key, T& out) const {
+      bool found = false;
+      read([&](const Dict& dict) {
+        const T* value = dict.find(key);
+        if (value != nullptr) {
+          out = *value;
+          found = true;
+        }
+      });
+      return found;
+    }
+
+    // Call visit with the current table. The table stays valid, and
+    // unchanged, until visit returns, even if a new one is published
+    // meanwhile; visit must not keep references into it afterwards.
+    template <typename Visit>
+    void read(Visit visit) const {
+      reader_slot& slot = readers_[slot_index()];
+      unsigned parity;
+      for (;;) {
+        parity = epoch_.load() & 1;
+        slot.active[parity].fetch_add(1);
+        if ((epoch_.load() & 1) == parity) {
+          break;                                // the epoch did not flip under us
+        }
+        slot.active[parity].fetch_sub(1);
+      }
+      visit(static_cast<const Dict&>(*current_.load()));
+      slot.active[parity].fetch_sub(1, std::memory_order_release);
+    }
+
+    // Replace the current table with next, which must be fully built, and
+    // delete the old one once no reader can still be using it.
+    void publish(std::unique_ptr<Dict> next) {
+      std::lock_guard<std::mutex> guard(publish_lock_);
+      Dict* old = current_.exchange(next.release());
+      unsigned parity = epoch_.fetch_add(1) & 1;
+      for (size_t i = 0; i < READER_SLOTS; i++) {
+        while (readers_[i].active[parity].load() != 0) {
+          std::this_thread::yield();            // wait out readers that may hold old
+        }
+      }
+      delete old;
+      publications_++;
+    }
+
+    // Build a table holding the n given pairs and publish it.
+    void rebuild(const std::pair<uint32_t, T>* pairs, size_t n) {
+      publish(Dict::build_from(pairs, n));
+    }
+
+    // Build a table holding the given pairs on another thread and publish
+    // it there, returning at once. Wait for any earlier background rebuild
+    // first, so that tables are published in the order requested; if that
+    // rebuild failed, rethrow its exception instead of starting this one.
+    void rebuild_in_background(std::vector<std::pair<uint32_t, T>> pairs) {
+      wait();
+      pending_ = std::async(std::launch::async, [this, pairs = std::move(pairs)]() {
+        rebuild(pairs.data(), pairs.size());
+      });
+    }
+
+    // Wait until the last background rebuild, if any, has been published,
+    // and rethrow its exception if it failed.
+    void wait() {
+      if (pending_.valid()) {
+        pending_.get();
+      }
+    }
+
+    // Number of tables published so far, after the first.
+    uint64_t publications() const noexcept {
+      return publications_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Readers inside a read section, by the epoch parity they entered under.
+    struct alignas(CACHE_LINE) reader_slot {
+      std::atomic<uint64_t> active[2] = {{0}, {0}};
+    };
+
+    std::atomic<Dict*> current_;                  // the table readers see
+    std::unique_ptr<reader_slot[]> readers_;
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint64_t> publications_{0};
+    std::mutex publish_lock_;                     // serializes publish()
+    std::future<void> pending_;                   // the background rebuild, if any
+
+    static size_t slot_index() noexcept {
+      static thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_SLOTS;
+      return index;
+    }
+  };
+
+  // Unbounded multi-producer single-consumer queue of intrusive nodes, after
+  // Dmitry Vyukov's design. Node must have a std::atomic<Node*> next member.
+  // Any thread may push, with one atomic exchange and no loop; only one
+  // thread may pop. A pop can return nullptr while a push is half done, in
+  // which case the node shows up on a later pop.
+  template <typename Node>
+  class mpsc_queue {
+  public:
+
+    mpsc_queue() : head_(&stub_), tail_(&stub_) {
+      stub_.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    void push(Node* node) noexcept {
+      node->next.store(nullptr, std::memory_order_relaxed);
+      Node* previous = head_.exchange(node);        // seq_cst: see empty()
+      previous->next.store(node, std::memory_order_release);
+    }
+
+    // True if no node has been pushed that pop() has not yet returned,
+    // counting pushes still between their two steps. Only the consumer may
+    // call this. Pushes and this check are seq_cst, so a consumer that
+    // publishes a flag seq_cst and then finds the queue empty is sure any
+    // later pusher will see the flag.
+    bool empty() const noexcept {
+      return tail_ == &stub_ && head_.load() == &stub_;
+    }
+
+    // Remove and return the oldest node, or nullptr if there is none yet.
+    Node* pop() noexcept {
+      Node* tail = tail_;
+      Node* next = tail->next.load(std::memory_order_acquire);
+      if (tail == &stub_) {
+        if (next == nullptr) {
+          return nullptr;
+        }
+        tail_ = tail = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+      if (next != nullptr) {
+        tail_ = next;
+        return tail;
+      }
+      if (tail != head_.load(std::memory_order_acquire)) {
+        return nullptr;                           // a push is between its two steps
+      }
+      push(&stub_);                               // tail is the last node: put the stub behind it
+      next = tail->next.load(std::memory_order_acquire);
+      if (next != nullptr) {
+        tail_ = next;
+        return tail;
+      }
+      return nullptr;
+    }
+
+  private:
+    alignas(CACHE_LINE) std::atomic<Node*> head_;   // last node pushed, written by producers
+    alignas(CACHE_LINE) Node* tail_;                // next node to pop, owned by the consumer
+    Node stub_;
+  };
+
+  // A table split into shards, each an Inner dictionary owned by one server
+  // thread, by default one per core. A key's hash picks its shard. Callers
+  // never touch a shard: they push a request onto the shard's lock-free
+  // MPSC queue and wait for the server to answer it, so each Inner is only
+  // ever used by one thread, needs no locks, and stays in that core's cache.
+  // Server i is pinned to core i, modulo the number of hardware threads; a
+  // server with no requests backs off and then sleeps until one is pushed.
+  // If the Inner throws, the exception is passed back to the caller.
+  template <typename T, typename Inner = chain_dict<T>>
+  class sharded_dict : public abstract_concurrent_dict<T> {
+  public:
+
+    // Create an empty dictionary with the given total capacity, split over
+    // the given number of shards (0 for one per hardware thread).
+    sharded_dict(size_t capacity, unsigned shards = 0)
+    : shard_count_(shards != 0 ? shards : std::max(1u, std::thread::hardware_concurrency())),
+      shards_(new shard[shard_count_]) {
+      for (unsigned i = 0; i < shard_count_; i++) {
+        shards_[i].table.reset(new Inner(std::max<size_t>(capacity / shard_count_, 1)));
+      }
+      for (unsigned i = 0; i < shard_count_; i++) {
+        shards_[i].server = std::thread([this, i]() {
+          pin_to_core(i % std::max(1u, std::thread::hardware_concurrency()));
+          serve(shards_[i]);
+        });
+      }
+    }
+
+    ~sharded_dict() {
+      stop_ = true;
+      for (unsigned i = 0; i < shard_count_; i++) {
+        {
+          std::lock_guard<std::mutex> lock(shards_[i].wake_lock);
+        }
+        shards_[i].wake.notify_one();
+        shards_[i].server.join();
+      }
+    }
+
+    sharded_dict(const sharded_dict&) = delete;
+    sharded_dict& operator=(const sharded_dict&) = delete;
+
+    virtual bool find(uint32_t key, T& out) const {
+      request req(request::FIND, key);
+      send(req);
+      if (req.result) {
+        out = std::move(req.value);
+      }
+      return req.result;
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      request req(request::SET, key);
+      req.value = std::move(val);
+      send(req);
+    }
+
+    virtual bool erase(uint32_t key) {
+      request req(request::ERASE, key);
+      send(req);
+      return req.result;
+    }
+
+    // Number of shards, and so of server threads.
+    unsigned shards() const noexcept { return shard_count_; }
+
+  private:
+    // One operation, living on the caller's stack until it is answered.
+    struct request {
+      enum kind { FIND, SET, ERASE };
+
+      request(kind op = FIND, uint32_t key = 0) : op(op), key(key) { }
+
+      std::atomic<request*> next{nullptr};        // queue link
+      kind op;
+      uint32_t key;
+      T value{};                                  // in for SET, out for FIND
+      bool result = false;                        // found, or erased
+      std::exception_ptr error;
+      std::atomic<bool> done{false};              // set by the server last
+    };
+
+    struct alignas(CACHE_LINE) shard {
+      mpsc_queue<request> queue;
+      std::unique_ptr<Inner> table;               // used only by server
+      std::thread server;
+      std::atomic<bool> sleeping{false};          // server is, or is about to be, waiting on wake
+      std::mutex wake_lock;
+      std::condition_variable wake;
+    };
+
+    // Yields an idle server makes before it goes to sleep.
+    static constexpr unsigned IDLE_YIELDS = 64;
+
+    unsigned shard_count_;
+    std::unique_ptr<shard[]> shards_;
+    poly2_hash_func hashfxn;                      // picks the shard
+    std::atomic<bool> stop_{false};
+
+    // Hand req to its shard and wait for the answer. Rethrow anything the
+    // shard's table threw.
+    void send(request& req) const {
+      uint32_t hash = hashfxn.hash(req.key);
+      shard& owner = shards_[(uint64_t(hash) * shard_count_) >> 32];
+      owner.queue.push(&req);
+      // The push and this load, and the server's store to sleeping and its
+      // empty() check, are all seq_cst: either the server sees the push
+      // before it sleeps, or this thread sees it sleeping and wakes it.
+      if (owner.sleeping.load()) {
+        {
+          std::lock_guard<std::mutex> lock(owner.wake_lock);
+        }
+        owner.wake.notify_one();
+      }
+      backoff wait;
+      while (!req.done.load(std::memory_order_acquire)) {
+        wait.pause();
+      }
+      if (req.error) {
+        std::rethrow_exception(req.error);
+      }
+    }
+
+    // Answer owner's requests until the dictionary is destroyed.
+    void serve(shard& owner) {
+      backoff idle;
+      while (!stop_.load(std::memory_order_relaxed)) {
+        request* req = owner.queue.pop();
+        if (req == nullptr) {
+          if (idle.yields() < IDLE_YIELDS) {
+            idle.pause();
+            continue;
+          }
+          std::unique_lock<std::mutex> lock(owner.wake_lock);
+          owner.sleeping.store(true);
+          owner.wake.wait(lock, [&]() { return !owner.queue.empty() || stop_.load(); });
+          owner.sleeping.store(false, std::memory_order_relaxed);
+          idle.reset();
+          continue;
+        }
+        idle.reset();
+        try {
+          switch (req->op) {
+          case request::FIND:
+            if (const T* value = owner.table->find(req->key)) {
+              req->value = *value;
+              req->result = true;
+            }
+            break;
+          case request::SET:
+            owner.table->set(req->key, std::move(req->value));
+            break;
+          case request::ERASE:
+            req->result = owner.table->erase(req->key);
+            break;
+          }
+        } catch (...) {
+          req->error = std::current_exception();
+        }
+        req->done.store(true, std::memory_order_release);
+      }
+    }
+  };
+}
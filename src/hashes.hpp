@@ -1,23 +1,309 @@
 ///////////////////////////////////////////////////////////////////////////////
 // hashes.hpp
 //
-// Implementations of four dictionary data structures: naive, chained hash
-// table, linear probing hash table, and cuckoo hash table.
+// Implementations of dictionary data structures: naive, chained hash table,
+// open addressing hash table (linear, quadratic or double-hash probing),
+// Robin Hood hash table, cuckoo hash table, SwissTable-style hash table with
+// SIMD control-byte groups, linear probing over a flat key array with
+// AVX2/AVX-512 group probes, a small map scanned with AVX2 that grows into
+// a hash table, and ordered dictionaries over sorted arrays searched by
+// branchless binary search or in Eytzinger layout.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASHES_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Wider x86 vector units are chosen at runtime, so their kernels are compiled
+// for the instruction set explicitly rather than for the whole build.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HASHES_HAVE_X86 1
+#define HASHES_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define HASHES_HAVE_X86 1
+#define HASHES_TARGET(isa)
+#include <immintrin.h>
+#endif
+
 namespace hashes {
 
   const uint32_t LARGE_PRIME = 2147483647; // largest prime less than 2^31
 
   class key_exception { };
 
+  // Summary of probe lengths over the occupied slots of an open-addressing
+  // table. A probe length is the number of slots a successful search for
+  // that entry inspects.
+  struct probe_stats {
+    size_t max_length;
+    double mean_length;
+    double load_factor;                 // occupied slots / all slots
+  };
+
+  // Index of the lowest set bit of a nonzero mask.
+  inline unsigned lowest_bit(uint32_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+
+  // Index of the highest set bit of a nonzero value.
+  inline unsigned highest_bit(uint64_t value) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+  }
+
+  // The MurmurHash3 finalizer: a bijection on 32-bit values under which
+  // every output bit depends on every input bit. The low bits of a
+  // polynomial hash mod 2^32 depend only on the low bits of the key, so
+  // keys that share their low bits, such as strided keys, would all land
+  // in the same few slots of a power-of-two table. Tables that reduce a
+  // hash to a power of two mix it first.
+  inline uint32_t mix_bits(uint32_t hash) noexcept {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+  }
+
+  // Number of keys that search_batch hashes and prefetches together before
+  // resolving any of them. Enough to keep several cache misses in flight
+  // without evicting the first group's lines before they are used.
+  const size_t BATCH_GROUP = 16;
+
+  // Bytes of table that insert_batch aims to fill at a time: about the size
+  // of a per-core L2 cache.
+  const size_t BATCH_REGION_BYTES = 256 * 1024;
+
+  // Order in which insert_batch should insert a batch of entries, given the
+  // home slot of each entry in a table of table_slots slots of slot_bytes
+  // bytes each. The table is cut into regions of about BATCH_REGION_BYTES,
+  // and the batch positions are radix-partitioned by region, in table
+  // order. Positions are staged in one cache line per partition and copied
+  // out a whole line at a time (software write-combining), so the scatter
+  // itself does not miss on every write.
+  inline std::vector<uint32_t> partition_by_region(const std::vector<size_t>& homes,
+                                                   size_t table_slots, size_t slot_bytes) {
+    const size_t LINE = 64 / sizeof(uint32_t);
+    size_t partitions = (table_slots * slot_bytes + BATCH_REGION_BYTES - 1) / BATCH_REGION_BYTES;
+    partitions = std::min<size_t>(std::max<size_t>(partitions, 1), 4096);
+
+    // histogram, then prefix sums give each partition's start in the output
+    std::vector<uint32_t> part(homes.size());
+    std::vector<size_t> next(partitions + 1, 0);
+    for (size_t i = 0; i < homes.size(); i++) {
+      part[i] = uint32_t(homes[i] * partitions / table_slots);
+      next[part[i] + 1]++;
+    }
+    for (size_t p = 0; p < partitions; p++) {
+      next[p + 1] += next[p];
+    }
+
+    std::vector<uint32_t> order(homes.size());
+    std::vector<uint32_t> lines(partitions * LINE);
+    std::vector<uint8_t> fill(partitions, 0);
+    for (size_t i = 0; i < homes.size(); i++) {
+      uint32_t p = part[i];
+      lines[p * LINE + fill[p]++] = uint32_t(i);
+      if (fill[p] == LINE) {                        // line full: write it out in one go
+        std::copy(&lines[p * LINE], &lines[p * LINE] + LINE, &order[next[p]]);
+        next[p] += LINE;
+        fill[p] = 0;
+      }
+    }
+    for (size_t p = 0; p < partitions; p++) {      // flush partial lines
+      std::copy(&lines[p * LINE], &lines[p * LINE] + fill[p], &order[next[p]]);
+    }
+    return order;
+  }
+
+  // Positions of homes, ordered by home slot (a stable counting sort over
+  // table_slots buckets).
+  inline std::vector<uint32_t> sort_by_home(const std::vector<size_t>& homes, size_t table_slots) {
+    std::vector<size_t> next(table_slots + 1, 0);
+    for (size_t home : homes) {
+      next[home + 1]++;
+    }
+    for (size_t slot = 0; slot < table_slots; slot++) {
+      next[slot + 1] += next[slot];
+    }
+    std::vector<uint32_t> order(homes.size());
+    for (size_t i = 0; i < homes.size(); i++) {
+      order[next[homes[i]]++] = uint32_t(i);
+    }
+    return order;
+  }
+
+  // Remove from order, as returned by sort_by_home, every position whose key
+  // appears again later in pairs, so the last value of a repeated key wins.
+  // Repeated keys share a home slot, so only runs of equal homes are compared.
+  template <typename T>
+  void drop_repeated_keys(std::vector<uint32_t>& order, const std::vector<size_t>& homes,
+                          const std::pair<uint32_t, T>* pairs) {
+    size_t kept = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+      bool repeated = false;
+      for (size_t j = i + 1; j < order.size() && homes[order[j]] == homes[order[i]]; j++) {
+        repeated |= (pairs[order[j]].first == pairs[order[i]].first);
+      }
+      if (!repeated) {
+        order[kept++] = order[i];
+      }
+    }
+    order.resize(kept);
+  }
+
+  // Call work(t) for t = 0 .. threads - 1, each on its own thread (the last
+  // on the calling one), and return when all have finished.
+  template <typename Work>
+  void run_in_parallel(unsigned threads, Work work) {
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t + 1 < threads; t++) {
+      workers.emplace_back(work, t);
+    }
+    work(threads - 1);
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // The first slot of region r when table_slots slots are split into
+  // regions contiguous ranges; home h lies in region h * regions / table_slots.
+  inline size_t region_begin(size_t r, size_t table_slots, unsigned regions) noexcept {
+    return (r * table_slots + regions - 1) / regions;
+  }
+
+  // Split the positions of homes by region, one region per thread, and
+  // return them with region r at [starts[r], starts[r + 1]), each region in
+  // input order. Every thread counts and then scatters its own contiguous
+  // share of the input into offsets no other thread writes, so the pass
+  // takes no locks.
+  inline std::vector<uint32_t> partition_by_home_range(const std::vector<size_t>& homes,
+                                                       size_t table_slots, unsigned threads,
+                                                       std::vector<size_t>& starts) {
+    size_t n = homes.size();
+    std::vector<size_t> counts(size_t(threads) * threads, 0);   // [share][region]
+    auto region_of = [&](size_t i) { return size_t(homes[i] * threads / table_slots); };
+    run_in_parallel(threads, [&](unsigned t) {
+      for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+        counts[t * threads + region_of(i)]++;
+      }
+    });
+
+    // offsets: region-major, then by share, so each region stays in input order
+    starts.assign(threads + 1, 0);
+    size_t offset = 0;
+    for (unsigned r = 0; r < threads; r++) {
+      starts[r] = offset;
+      for (unsigned t = 0; t < threads; t++) {
+        size_t count = counts[t * threads + r];
+        counts[t * threads + r] = offset;
+        offset += count;
+      }
+    }
+    starts[threads] = offset;
+
+    std::vector<uint32_t> order(n);
+    run_in_parallel(threads, [&](unsigned t) {
+      for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+        order[counts[t * threads + region_of(i)]++] = uint32_t(i);
+      }
+    });
+    return order;
+  }
+
+  // Hint that the cache line holding address will be read soon. Never
+  // faults, so address may be null or stale.
+  inline void prefetch(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif HASHES_HAVE_SSE2
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+  }
+
+  // Vector instruction sets that SIMD kernels may be dispatched to, in
+  // increasing order of width.
+  enum class simd_level { scalar, avx2, avx512 };
+
+  inline const char* simd_level_name(simd_level level) noexcept {
+    switch (level) {
+    case simd_level::avx512: return "avx512";
+    case simd_level::avx2:   return "avx2";
+    default:                 return "scalar";
+    }
+  }
+
+  // Widest instruction set supported by both this CPU and the OS, asking
+  // the CPU each time. Use detect_simd() instead.
+  inline simd_level probe_simd() noexcept {
+#if HASHES_HAVE_X86 && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+      return simd_level::scalar;
+    }
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0) {           // no OSXSAVE, so no way to check AVX state
+      return simd_level::scalar;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) {
+      return simd_level::avx512;
+    }
+    if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6) {
+      return simd_level::avx2;
+    }
+#elif HASHES_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return simd_level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return simd_level::avx2;
+    }
+#endif
+    return simd_level::scalar;
+  }
+
+  // Widest instruction set supported by both this CPU and the OS. The CPU
+  // is only asked once, so small tables may call this on construction.
+  inline simd_level detect_simd() noexcept {
+    static const simd_level level = probe_simd();
+    return level;
+  }
+
   // One entry in a dictionary.
   template <typename T>
   class entry {
@@ -129,15 +415,45 @@ namespace hashes {
 
     virtual ~abstract_dict() { }
 
+    // Search for the entry matching key, and return a pointer to the
+    // corresponding value, or nullptr if there is no such key.
+    //
+    // The const overload never modifies the dictionary, so a fully built
+    // dictionary may be shared as const by any number of reader threads, as
+    // long as no thread modifies it meanwhile.
+    virtual const T* find(uint32_t key) const noexcept = 0;
+
+    // Derived classes only implement the const overload, and bring this one
+    // into scope with a using-declaration.
+    virtual T* find(uint32_t key) noexcept {
+      return const_cast<T*>(static_cast<const abstract_dict&>(*this).find(key));
+    }
+
+    // Return true if key is in the dictionary.
+    bool contains(uint32_t key) const noexcept {
+      return find(key) != nullptr;
+    }
+
     // Search for the entry matching key, and return a reference to the
     // corresponding value.
     //
-    // Throw std::out_of_range if there is no such key.
-    //
-    // (It would be better C++ practice to also provide a const overload of
-    // this function, but that seems like busy-work for this experimental
-    // project, so we're skipping that.)
-    virtual T& search(uint32_t key) = 0;
+    // Throw std::out_of_range if there is no such key. Misses are expected
+    // in lookup-heavy code, so prefer find() there.
+    T& search(uint32_t key) {
+      T* value = find(key);
+      if (value == nullptr) {
+        throw std::out_of_range("key absent in abstract_dict::search");
+      }
+      return *value;
+    }
+
+    const T& search(uint32_t key) const {
+      const T* value = find(key);
+      if (value == nullptr) {
+        throw std::out_of_range("key absent in abstract_dict::search");
+      }
+      return *value;
+    }
 
     // Assign key to be associated with val. If key is already in the dictionary,
     // replace that association.
@@ -145,6 +461,56 @@ namespace hashes {
     // Throw std::length_error if the dictionary is too full to add another
     // entry.
     virtual void set(uint32_t key, T&& val) = 0;
+
+    // Assign keys[i] to be associated with values[i] for each i < n, with the
+    // same result as calling set for each in turn. Hash tables insert the
+    // batch one table region at a time (see partition_by_region), so each
+    // region stays in cache while it is written instead of every insert
+    // missing somewhere in a table much larger than the cache.
+    void insert_batch(const uint32_t* keys, const T* values, size_t n) {
+      std::vector<size_t> homes(n);
+      for (size_t i = 0; i < n; i++) {
+        homes[i] = home_slot(keys[i]);
+      }
+      // a key repeated in the batch must keep its last value, so the
+      // partitioning has to be stable, which it is
+      for (uint32_t i : partition_by_region(homes, table_slots(), slot_bytes())) {
+        T value = values[i];
+        set(keys[i], std::move(value));
+      }
+    }
+
+    // Look up n keys at once. out[i] is set to the address of the value for
+    // keys[i], or nullptr if keys[i] is absent. Hash tables hash a group of
+    // keys and prefetch their slots before resolving any of them, so the
+    // cache misses of a group overlap instead of being paid one by one.
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) = 0;
+
+    // Remove key and its associated value. Return true if key was present,
+    // false if it was absent.
+    virtual bool erase(uint32_t key) = 0;
+
+    // Number of slots (or buckets) in the hash table, or 1 for
+    // dictionaries without one.
+    size_t slots() const noexcept {
+      return table_slots();
+    }
+
+    // The slot (or bucket) below slots() that key's search starts from, or
+    // 0 for dictionaries without a hashed table.
+    size_t home(uint32_t key) const noexcept {
+      return home_slot(key);
+    }
+
+  protected:
+
+    // The table slot that key's search starts from, the number of slots,
+    // and the bytes per slot, for insert_batch. Dictionaries without a
+    // hashed table keep these defaults, which put the whole batch in one
+    // region.
+    virtual size_t home_slot(uint32_t) const noexcept { return 0; }
+    virtual size_t table_slots() const noexcept { return 1; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(entry<T>); }
   };
 
   // Naive dictionary (unsorted vector).
@@ -156,12 +522,17 @@ namespace hashes {
     naive_dict(size_t capacity) {
     }
 
-    virtual T& search(uint32_t key) {
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
       auto iter = search_iterator(key);
-      if (iter != entries_.end()) {
-        return iter->value();
-      } else {
-        throw std::out_of_range("key absent in naive_dict::search");
+      return (iter != entries_.end()) ? &iter->value() : nullptr;
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      for (size_t i = 0; i < n; i++) {              // nothing to prefetch in a linear scan
+        auto iter = search_iterator(keys[i]);
+        out[i] = (iter != entries_.end()) ? &iter->value() : nullptr;
       }
     }
 
@@ -174,6 +545,18 @@ namespace hashes {
       }
     }
 
+    virtual bool erase(uint32_t key) {
+      auto iter = search_iterator(key);
+      if (iter == entries_.end()) {
+        return false;
+      }
+      if (iter != entries_.end() - 1) {
+        *iter = std::move(entries_.back());      // order is irrelevant, so fill the hole from the back
+      }
+      entries_.pop_back();
+      return true;
+    }
+
   private:
 
     std::vector<entry<T>> entries_;
@@ -184,6 +567,12 @@ namespace hashes {
                           [&](entry<T>& entry) { return entry.key() == key; });
     }
 
+    typename std::vector<entry<T>>::const_iterator search_iterator(uint32_t key) const {
+      return std::find_if(entries_.begin(),
+                          entries_.end(),
+                          [&](const entry<T>& entry) { return entry.key() == key; });
+    }
+
   };
 
   // Hash table with chaining.
@@ -197,14 +586,103 @@ namespace hashes {
       entries_.resize(capacity);                        // resize hash table to capacity 
     }
 
-    virtual T& search(uint32_t key) {
+    // Create a dictionary holding the n given pairs, with one bucket per
+    // pair. A counting pass sizes every bucket exactly before any entry is
+    // placed, so no bucket reallocates. If unique_keys is true the caller
+    // guarantees that no key repeats, and duplicate checks are skipped;
+    // otherwise a repeated key keeps its last value.
+    static std::unique_ptr<chain_dict> build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                                  bool unique_keys = false) {
+      std::unique_ptr<chain_dict> dict(new chain_dict(std::max<size_t>(n, 1)));
+      std::vector<unsigned int> buckets(n);
+      std::vector<size_t> counts(dict->size, 0);
+      for (size_t i = 0; i < n; i++) {                   // count entries per bucket
+        buckets[i] = dict->hashfxn.hash(pairs[i].first) % dict->size;
+        counts[buckets[i]]++;
+      }
+      for (int b = 0; b < dict->size; b++) {
+        dict->entries_[b].reserve(counts[b]);
+      }
+      for (size_t i = 0; i < n; i++) {                   // place
+        T value = pairs[i].second;
+        if (!unique_keys) {
+          auto iter = dict->search_iterator(pairs[i].first, buckets[i]);
+          if (iter != dict->entries_[buckets[i]].end()) {
+            iter->set_value(std::move(value));
+            continue;
+          }
+        }
+        dict->entries_[buckets[i]].emplace_back(pairs[i].first, std::move(value));
+      }
+      return dict;
+    }
+
+    // As build_from, but on the given number of threads. The buckets are
+    // split into one contiguous range per thread, the pairs are partitioned
+    // by the range their bucket falls in, and then each thread fills only
+    // its own buckets, so no locks are needed.
+    static std::unique_ptr<chain_dict> parallel_build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                                           unsigned threads, bool unique_keys = false) {
+      threads = std::max(threads, 1u);
+      std::unique_ptr<chain_dict> dict(new chain_dict(std::max<size_t>(n, 1)));
+      std::vector<size_t> buckets(n);
+      run_in_parallel(threads, [&](unsigned t) {
+        for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+          buckets[i] = dict->hashfxn.hash(pairs[i].first) % dict->size;
+        }
+      });
+      std::vector<size_t> starts;
+      std::vector<uint32_t> order = partition_by_home_range(buckets, dict->size, threads, starts);
+
+      run_in_parallel(threads, [&](unsigned r) {
+        size_t first_bucket = region_begin(r, dict->size, threads);
+        std::vector<size_t> counts(region_begin(r + 1, dict->size, threads) - first_bucket, 0);
+        for (size_t j = starts[r]; j < starts[r + 1]; j++) {     // count entries per bucket
+          counts[buckets[order[j]] - first_bucket]++;
+        }
+        for (size_t b = 0; b < counts.size(); b++) {
+          dict->entries_[first_bucket + b].reserve(counts[b]);
+        }
+        for (size_t j = starts[r]; j < starts[r + 1]; j++) {     // place
+          uint32_t i = order[j];
+          T value = pairs[i].second;
+          if (!unique_keys) {
+            auto iter = dict->search_iterator(pairs[i].first, buckets[i]);
+            if (iter != dict->entries_[buckets[i]].end()) {
+              iter->set_value(std::move(value));
+              continue;
+            }
+          }
+          dict->entries_[buckets[i]].emplace_back(pairs[i].first, std::move(value));
+        }
+      });
+      return dict;
+    }
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
       unsigned int bucket = hashfxn.hash(key) % size;    // use polynomial2 hash function on key
-      auto iter = search_iterator(key, bucket);           // initialize iterator
+      return find_in_bucket(key, bucket);                // search for corresponding value to key
+    }
 
-      if (iter != entries_.at(bucket).end()) {       // search for corresponding value to key
-          return iter->value();                      // return value if found 
+    // Each bucket is a vector, so a lookup misses twice: once on the vector
+    // header and once on its entries. Both are prefetched a group ahead.
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      unsigned int buckets[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {                // hash, prefetch bucket headers
+          buckets[i] = hashfxn.hash(keys[first + i]) % size;
+          prefetch(&entries_[buckets[i]]);
+        }
+        for (size_t i = 0; i < count; i++) {                // prefetch bucket contents
+          prefetch(entries_[buckets[i]].data());
+        }
+        for (size_t i = 0; i < count; i++) {                // resolve
+          out[first + i] = const_cast<T*>(find_in_bucket(keys[first + i], buckets[i]));
+        }
       }
-      throw std::out_of_range("key absent in chain_dict::search");      // throw exception if not found 
     }
 
     virtual void set(uint32_t key, T&& val) {
@@ -219,6 +697,26 @@ namespace hashes {
       }
     }
 
+    virtual bool erase(uint32_t key) {
+      unsigned int bucket = hashfxn.hash(key) % size;    // use polynomial2 hash function on key
+      auto& chain = entries_.at(bucket);
+      auto iter = search_iterator(key, bucket);
+
+      if (iter == chain.end()) {
+        return false;                                  // key not in bucket
+      }
+      if (iter != chain.end() - 1) {
+        *iter = std::move(chain.back());               // swap the last entry of the bucket into the hole
+      }
+      chain.pop_back();                                // and pop it, keeping the bucket contiguous
+      return true;
+    }
+
+  protected:
+    virtual size_t home_slot(uint32_t key) const noexcept { return hashfxn.hash(key) % size; }
+    virtual size_t table_slots() const noexcept { return size; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(std::vector<entry<T>>) + sizeof(entry<T>); }
+
   private:
     int size;       
     std::vector<std::vector<entry<T>>> entries_;       // hash table with buckets as elements 
@@ -229,58 +727,595 @@ namespace hashes {
                           entries_.at(bucket).end(),
                           [&](entry<T>& entry) { return entry.key() == key; });
     }
+
+    const T* find_in_bucket(uint32_t key, unsigned int bucket) const {      // value of key in bucket, or nullptr
+      auto iter = std::find_if(entries_.at(bucket).begin(),
+                               entries_.at(bucket).end(),
+                               [&](const entry<T>& entry) { return entry.key() == key; });
+      return (iter != entries_.at(bucket).end()) ? &iter->value() : nullptr;
+    }
   };
 
-  // Hash table with linear probing (LP).
-  template <typename T>
+  // Smallest power of two that is at least n (and at least 1).
+  inline size_t next_power_of_two(size_t n) noexcept {
+    size_t power = 1;
+    while (power < n) {
+      power <<= 1;
+    }
+    return power;
+  }
+
+  // Probe sequences for open addressing. A policy chooses a per-key step,
+  // and the slot visited after index on the given attempt (counting from 1).
+  // Each sequence visits every slot once within its first size probes; the
+  // quadratic and double hashing sequences need a power-of-two size for
+  // that, so lp_dict runs them over the next power of two and skips the
+  // positions past its table.
+
+  // Linear probing: h, h+1, h+2, ...
+  class linear_probe {
+  public:
+
+    uint32_t step(uint32_t) const noexcept { return 1; }
+
+    size_t next(size_t index, size_t, uint32_t, size_t size) const noexcept {
+      return (index + 1) % size;
+    }
+  };
+
+  // Quadratic probing by triangular numbers: h, h+1, h+3, h+6, ... This only
+  // covers every slot when the table size is a power of two.
+  class quadratic_probe {
+  public:
+
+    uint32_t step(uint32_t) const noexcept { return 1; }
+
+    size_t next(size_t index, size_t attempt, uint32_t, size_t size) const noexcept {
+      return (index + attempt) & (size - 1);
+    }
+  };
+
+  // Double hashing: h, h+s, h+2s, ... where s comes from a second hash
+  // function of the same family as lp_dict's. s is forced odd, so s and a
+  // power-of-two table size are coprime.
+  class double_hash_probe {
+  public:
+
+    uint32_t step(uint32_t key) const noexcept { return mix_bits(hashfxn.hash(key)) | 1; }
+
+    size_t next(size_t index, size_t, uint32_t step, size_t size) const noexcept {
+      return (index + step) & (size - 1);
+    }
+
+  private:
+    poly5_hash_func hashfxn;            // hash function for the step
+  };
+
+  // Hash table with open addressing. Probe is the probe sequence policy;
+  // the default is linear probing (LP). Every policy gets the same table
+  // for a given capacity and load factor, so policies are compared at
+  // equal load.
+  template <typename T, typename Probe = linear_probe>
   class lp_dict : public abstract_dict<T> {
   public:
 
-    // Create an empty dictionary, with the given capacity.
-    lp_dict(size_t capacity) {
-      this->size = capacity;                                   // set hash table size to the given capacity
+    // Load factor that build_from and parallel_build_from size tables for.
+    static constexpr double BUILD_LOAD = 0.7;
+
+    // Create an empty dictionary with room for capacity entries at a load
+    // factor of max_load: a table of capacity / max_load slots, so by
+    // default exactly capacity. Throw std::invalid_argument if max_load is
+    // not positive.
+    lp_dict(size_t capacity, double max_load = 1) {
+      if (!(max_load > 0)) {
+        throw std::invalid_argument("lp_dict max_load must be positive");
+      }
+      this->size = int(std::max(1.0, std::ceil(capacity / max_load)));  // set hash table size from the given capacity
+      span_ = std::is_same<Probe, linear_probe>::value ? size_t(size) : next_power_of_two(size);
       entries_ = new std::vector<entry<T>*>(size);             // initialize entries_ to point to a vector
       for (int i = 0; i < size; i++) {                           
         entries_->at(i) = nullptr;                             // set all pointers in vector to nullptr
       }
     }
 
-    virtual T& search(uint32_t key) {
-      unsigned int index = hashfxn.hash(key) % size;            // use polynomial5 hash function on key
-      int counter = 0;                                          // initialize counter to 0 
+    // Free every stored entry (erased slots share the tombstone, which is
+    // not ours to free), then the table itself.
+    ~lp_dict() {
+      for (entry<T>* slot : *entries_) {
+        if (slot != nullptr && slot != tombstone()) {
+          delete slot;
+        }
+      }
+      delete entries_;
+    }
+
+    // The table owns its entries through raw pointers, so a member-wise
+    // copy would free them twice.
+    lp_dict(const lp_dict&) = delete;
+    lp_dict& operator=(const lp_dict&) = delete;
+
+    // Create a dictionary holding the n given pairs, in a table with room
+    // for n at a load factor of BUILD_LOAD. Entries are counting-sorted by
+    // home slot and placed in that order.
+    // With linear probing each entry then lands in the first free slot at
+    // or after its home, which is just past the previous entry's slot when
+    // their runs meet, so placement needs no probing at all; entries that
+    // run off the end of the table wrap around through set(). Other probe
+    // sequences insert in home order through set(). If unique_keys is true
+    // the caller guarantees that no key repeats; otherwise a repeated key
+    // keeps its last value.
+    static std::unique_ptr<lp_dict> build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                               bool unique_keys = false) {
+      std::unique_ptr<lp_dict> dict(new lp_dict(std::max<size_t>(n, 1), BUILD_LOAD));
+      std::vector<size_t> homes(n);
+      for (size_t i = 0; i < n; i++) {
+        homes[i] = dict->home_slot(pairs[i].first);
+      }
+      std::vector<uint32_t> order = sort_by_home(homes, dict->size);
+      if (!unique_keys) {
+        drop_repeated_keys(order, homes, pairs);
+      }
+
+      std::vector<uint32_t> wrapped;                           // entries that ran past the last slot
+      size_t cursor = 0;                                       // first slot not yet filled by this pass
+      for (uint32_t i : order) {
+        T value = pairs[i].second;
+        if (!std::is_same<Probe, linear_probe>::value) {
+          dict->set(pairs[i].first, std::move(value));
+          continue;
+        }
+        size_t slot = std::max(homes[i], cursor);
+        if (slot >= size_t(dict->size)) {
+          wrapped.push_back(i);
+          continue;
+        }
+        dict->entries_->at(slot) = new entry<T>(pairs[i].first, std::move(value));
+        cursor = slot + 1;
+      }
+      for (uint32_t i : wrapped) {
+        T value = pairs[i].second;
+        dict->set(pairs[i].first, std::move(value));
+      }
+      return dict;
+    }
 
-      while(entries_->at(index) != nullptr){                    // while element at index is not a nullptr
-        if (counter++ > size){                                  // if counter goes higher than the capacity (stopping condition)
-          throw std::out_of_range("key absent in lp_dict::search");     
+    // As build_from, but on the given number of threads. The table is split
+    // into one contiguous range of slots per thread, and the pairs are
+    // partitioned by the range their home slot falls in. Each thread then
+    // sorts its pairs by home and places them as build_from does, without
+    // locks since no other thread writes its slots; pairs that would run
+    // past the end of their range go through set() once all threads are
+    // done. Probe sequences other than linear probing leave the range, so
+    // they fall back to build_from.
+    static std::unique_ptr<lp_dict> parallel_build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                                        unsigned threads, bool unique_keys = false) {
+      threads = std::max(threads, 1u);
+      if (!std::is_same<Probe, linear_probe>::value) {
+        return build_from(pairs, n, unique_keys);
+      }
+      std::unique_ptr<lp_dict> dict(new lp_dict(std::max<size_t>(n, 1), BUILD_LOAD));
+      size_t slots = dict->size;
+      std::vector<size_t> homes(n);
+      run_in_parallel(threads, [&](unsigned t) {
+        for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++) {
+          homes[i] = dict->home_slot(pairs[i].first);
+        }
+      });
+      std::vector<size_t> starts;
+      std::vector<uint32_t> order = partition_by_home_range(homes, slots, threads, starts);
+
+      std::vector<std::vector<uint32_t>> spilled(threads);      // ran past their range
+      run_in_parallel(threads, [&](unsigned r) {
+        size_t first_slot = region_begin(r, slots, threads),
+               end_slot = region_begin(r + 1, slots, threads);
+        std::vector<size_t> next(end_slot - first_slot + 1, 0);  // counting sort by home
+        for (size_t j = starts[r]; j < starts[r + 1]; j++) {
+          next[homes[order[j]] - first_slot + 1]++;
+        }
+        for (size_t slot = 0; slot + 1 < next.size(); slot++) {
+          next[slot + 1] += next[slot];
+        }
+        std::vector<uint32_t> sorted(starts[r + 1] - starts[r]);
+        for (size_t j = starts[r]; j < starts[r + 1]; j++) {
+          sorted[next[homes[order[j]] - first_slot]++] = order[j];
+        }
+        if (!unique_keys) {
+          drop_repeated_keys(sorted, homes, pairs);
         }
 
-        if (entries_->at(index)->key() == key){                 // check if element's key at index is equal to our searched key
-          return entries_->at(index)->value();                  // return the value
+        size_t cursor = first_slot;
+        for (uint32_t i : sorted) {
+          size_t slot = std::max(homes[i], cursor);
+          if (slot >= end_slot) {
+            spilled[r].push_back(i);
+            continue;
+          }
+          T value = pairs[i].second;
+          (*dict->entries_)[slot] = new entry<T>(pairs[i].first, std::move(value));
+          cursor = slot + 1;
+        }
+      });
+      for (const auto& region : spilled) {
+        for (uint32_t i : region) {
+          T value = pairs[i].second;
+          dict->set(pairs[i].first, std::move(value));
         }
-        index++;                                      // search next index
-        index %= size;                                // wrap around end back to beginning of array with mod: i.e. 10%10 = 0.
       }
+      return dict;
+    }
 
-      throw std::out_of_range("key absent in lp_dict::search");
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      return find_from(key, home_of(key));
+    }
+
+    // Slots hold pointers, so a lookup misses on the slot and then on the
+    // entry it points to. Both are prefetched a group ahead.
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      unsigned int indexes[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {                    // hash, prefetch home slots
+          indexes[i] = home_of(keys[first + i]);
+          prefetch(entries_->data() + indexes[i]);
+        }
+        for (size_t i = 0; i < count; i++) {                    // prefetch the entries they point to
+          prefetch((*entries_)[indexes[i]]);
+        }
+        for (size_t i = 0; i < count; i++) {                    // resolve
+          out[first + i] = const_cast<T*>(find_from(keys[first + i], indexes[i]));
+        }
+      }
     }
 
     virtual void set(uint32_t key, T&& val) {
-      entry<T>* temp = new entry<T>(key,std::move(val));           // set temp to entry to insert 
+      size_t index = home_of(key);
+      uint32_t step = probe.step(key);                             // per-key step of the probe sequence
+      size_t attempt = 0;
+      int reuse = -1;                                              // first erased slot on the probe sequence
+
+      while(entries_->at(index) != nullptr){                       // check if index is occupied 
+        if (entries_->at(index) == tombstone()){
+          if (reuse < 0){
+            reuse = index;                                         // remember it, but keep looking for key
+          }
+        }
+        else if (entries_->at(index)->key() == key){               // key already present: replace its entry
+          delete entries_->at(index);
+          entries_->at(index) = new entry<T>(key,std::move(val));
+          return;
+        }
+        size_t next = next_slot(index, attempt, step);             // move to next index in the probe sequence
+        if (next == size_t(size)){                                 // every slot visited
+          break;
+        }
+        index = next;
+      }
+
+      if (reuse >= 0){
+        index = reuse;                                             // fill the earliest erased slot
+        tombstones_--;
+      }
+      else if (entries_->at(index) != nullptr){
+        throw std::length_error("lp_dict is full");
+      }
+      entries_->at(index) = new entry<T>(key,std::move(val));      // set pointer at index to the new entry 
+    }
 
-      unsigned int index = hashfxn.hash(key) % size;               // use polynomial5 hash function on key        
+    // With linear probing the rest of the run shifts back into the erased
+    // slot, as in flat_lp_dict, so no tombstones are left. Other probe
+    // sequences cannot be shifted, so the slot gets a tombstone that probe
+    // sequences passing through it step over; once a quarter of the table
+    // is tombstones the table is rehashed at its current size, so that
+    // misses and inserts still reach an empty slot soon.
+    virtual bool erase(uint32_t key) {
+      size_t index = home_of(key);
+      uint32_t step = probe.step(key);
+      size_t attempt = 0;
+
+      while(index != size_t(size) && entries_->at(index) != nullptr){
+        if (entries_->at(index) != tombstone() && entries_->at(index)->key() == key){
+          delete entries_->at(index);
+          if (std::is_same<Probe, linear_probe>::value){
+            shift_back(index);
+          }
+          else {
+            entries_->at(index) = tombstone();
+            if (++tombstones_ * 4 >= size_t(size)){
+              rehash();
+            }
+          }
+          return true;
+        }
+        index = next_slot(index, attempt, step);
+      }
+      return false;
+    }
 
-      while(entries_->at(index) != nullptr && entries_->at(index)->key() != key){    // check if index is occupied 
-        index++;                                                   // increment index 
-        index %= size;                                             // wrap around end back to beginning of table 
+    // Longest and average probe length over all stored entries.
+    probe_stats probe_lengths() const {
+      probe_stats stats{0, 0.0, 0.0};
+      size_t total = 0, count = 0;
+      for (int i = 0; i < size; i++) {
+        if (entries_->at(i) == nullptr || entries_->at(i) == tombstone()) {
+          continue;
+        }
+        uint32_t key = entries_->at(i)->key();
+        size_t index = home_of(key);
+        uint32_t step = probe.step(key);
+        size_t attempt = 0, length = 1;
+        while (index != size_t(i)) {                               // replay the probe sequence up to slot i
+          index = next_slot(index, attempt, step);
+          length++;
+        }
+        stats.max_length = std::max(stats.max_length, length);
+        total += length;
+        count++;
       }
-      // null pointer or key at index is current key
-      entries_->at(index) = temp;                                  // set pointer at index to temp 
+      if (count > 0) {
+        stats.mean_length = double(total) / count;
+      }
+      stats.load_factor = double(count) / size;
+      return stats;
     }
 
+  protected:
+    virtual size_t home_slot(uint32_t key) const noexcept { return home_of(key); }
+    virtual size_t table_slots() const noexcept { return size; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(entry<T>*); }
+
   private:
     int size;                           // size of hash table
+    size_t span_;                       // probe positions that cover every slot
+    size_t tombstones_ = 0;             // erased slots not yet reused
     std::vector<entry<T>*>* entries_;   // hash table is pointer to vector of pointers
     poly5_hash_func hashfxn;            // hash function 
+    Probe probe;                        // probe sequence
+
+    // The slot key's probe sequence starts from. The hash is mixed first,
+    // so that keys sharing their low bits do not share a home when the
+    // table size is a power of two.
+    size_t home_of(uint32_t key) const noexcept {
+      return mix_bits(hashfxn.hash(key)) % size;
+    }
+
+    // The slot after index on a probe sequence with the given step, where
+    // attempt counts the positions tried so far, or size once all span_
+    // positions have been tried. Linear probing wraps at the table's end;
+    // the other sequences run over span_, a power of two, and positions at
+    // or past size are skipped, so every slot still comes up exactly once.
+    size_t next_slot(size_t index, size_t& attempt, uint32_t step) const noexcept {
+      while (++attempt < span_) {
+        index = probe.next(index, attempt, step, span_);
+        if (index < size_t(size)) {
+          return index;
+        }
+      }
+      return size;
+    }
+
+    // Value of key, whose probe sequence starts at index, or nullptr.
+    const T* find_from(uint32_t key, size_t index) const {
+      uint32_t step = probe.step(key);                          // per-key step of the probe sequence
+      size_t attempt = 0;                                       // positions tried so far
+
+      while(index != size_t(size) &&                            // stop once every slot has been tried
+            entries_->at(index) != nullptr){                    // while element at index is not a nullptr
+        if (entries_->at(index) != tombstone() &&               // skip erased slots
+            entries_->at(index)->key() == key){                 // check if element's key at index is equal to our searched key
+          return &entries_->at(index)->value();                 // return the value
+        }
+        index = next_slot(index, attempt, step);                // search next index in the probe sequence
+      }
+      return nullptr;
+    }
+
+    // Marker stored in place of an erased entry.
+    static entry<T>* tombstone() noexcept {
+      static entry<T> marker;
+      return &marker;
+    }
+
+    // Empty the linear-probing slot hole, then walk the rest of its run,
+    // moving back every entry whose home slot does not lie cyclically in
+    // (hole, index]. The hole is always empty, so the walk ends even in a
+    // full table.
+    void shift_back(size_t hole) {
+      entries_->at(hole) = nullptr;
+      for (size_t index = (hole + 1) % size; entries_->at(index) != nullptr; index = (index + 1) % size) {
+        size_t home = home_of(entries_->at(index)->key());
+        bool stays = (hole <= index) ? (hole < home && home <= index)
+                                     : (hole < home || home <= index);
+        if (!stays) {
+          entries_->at(hole) = entries_->at(index);
+          entries_->at(index) = nullptr;
+          hole = index;
+        }
+      }
+    }
+
+    // Put every stored entry back on its probe sequence in an emptied
+    // table of the same size, which clears all tombstones.
+    void rehash() {
+      std::vector<entry<T>*> stored;
+      for (entry<T>*& slot : *entries_) {
+        if (slot != nullptr && slot != tombstone()) {
+          stored.push_back(slot);
+        }
+        slot = nullptr;
+      }
+      tombstones_ = 0;
+      for (entry<T>* current : stored) {
+        size_t index = home_of(current->key());
+        uint32_t step = probe.step(current->key());
+        size_t attempt = 0;
+        while (entries_->at(index) != nullptr) {                  // the table has room for all of them
+          index = next_slot(index, attempt, step);
+        }
+        entries_->at(index) = current;
+      }
+    }
+  };
+
+  // Hash table with linear probing and Robin Hood displacement. Every slot
+  // records how far it sits from its home slot; an insert that meets an entry
+  // closer to home than itself takes that slot and carries the evicted entry
+  // onward. This keeps probe lengths short and uniform at high load, and lets
+  // an unsuccessful search stop as soon as it passes an entry nearer to home
+  // than the key would be. Deletion shifts the rest of the run back one slot
+  // instead of leaving tombstones.
+  template <typename T>
+  class robin_hood_dict : public abstract_dict<T> {
+  public:
+
+    // Create an empty dictionary with room for capacity entries at a load
+    // factor of max_load, sized as lp_dict is: capacity / max_load slots.
+    // Throw std::invalid_argument if max_load is not positive.
+    robin_hood_dict(size_t capacity, double max_load = 1)
+    : size_(slots_for(capacity, max_load)), count_(0), slots_(size_) { }
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      size_t index = find_index(key);
+      return (index != size_) ? &slots_[index].item.value() : nullptr;
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      size_t indexes[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {          // hash, prefetch home slots
+          indexes[i] = home_of(keys[first + i]);
+          prefetch(&slots_[indexes[i]]);
+        }
+        for (size_t i = 0; i < count; i++) {          // resolve
+          size_t index = find_index(keys[first + i], indexes[i]);
+          out[first + i] = (index != size_) ? &slots_[index].item.value() : nullptr;
+        }
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      if (count_ == size_) {                        // no empty slot left, so only an update can succeed
+        size_t index = find_index(key);
+        if (index == size_) {
+          throw std::length_error("robin_hood_dict is full");
+        }
+        slots_[index].item.set_value(std::move(val));
+        return;
+      }
+
+      entry<T> carried(key, std::move(val));        // entry looking for a slot
+      int distance = 0;                             // distance of carried from its home slot
+      bool displaced = false;                       // true once carried is an evicted entry
+      size_t index = home_of(key);
+
+      while (true) {
+        slot& current = slots_[index];
+        if (current.distance < 0) {                 // empty slot ends the run
+          current.item = std::move(carried);
+          current.distance = distance;
+          ++count_;
+          return;
+        }
+        if (!displaced && current.item.key() == key) {
+          current.item.set_value(std::move(carried.value()));
+          return;
+        }
+        if (current.distance < distance) {          // richer entry: take its slot and carry it on
+          std::swap(current.item, carried);
+          std::swap(current.distance, distance);
+          displaced = true;
+        }
+        index = (index + 1) % size_;
+        ++distance;
+      }
+    }
+
+    virtual bool erase(uint32_t key) {
+      size_t index = find_index(key);
+      if (index == size_) {
+        return false;
+      }
+
+      // shift the following entries back until one is already at home
+      size_t next = (index + 1) % size_;
+      while (slots_[next].distance > 0) {
+        slots_[index].item = std::move(slots_[next].item);
+        slots_[index].distance = slots_[next].distance - 1;
+        index = next;
+        next = (next + 1) % size_;
+      }
+      slots_[index].distance = -1;
+      --count_;
+      return true;
+    }
+
+    // Longest and average probe length over all stored entries.
+    probe_stats probe_lengths() const noexcept {
+      probe_stats stats{0, 0.0, 0.0};
+      size_t total = 0;
+      for (const slot& current : slots_) {
+        if (current.distance >= 0) {
+          size_t length = current.distance + 1;
+          stats.max_length = std::max(stats.max_length, length);
+          total += length;
+        }
+      }
+      if (count_ > 0) {
+        stats.mean_length = double(total) / count_;
+      }
+      stats.load_factor = double(count_) / size_;
+      return stats;
+    }
+
+  protected:
+    virtual size_t home_slot(uint32_t key) const noexcept { return home_of(key); }
+    virtual size_t table_slots() const noexcept { return size_; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(slot); }
+
+  private:
+    struct slot {
+      entry<T> item;
+      int distance = -1;                  // distance from home slot, or -1 if empty
+    };
+
+    size_t size_;                         // number of slots
+    size_t count_;                        // number of occupied slots
+    std::vector<slot> slots_;             // hash table stored inline
+    poly5_hash_func hashfxn;              // hash function
+
+    // Number of slots that hold capacity entries at load factor max_load.
+    static size_t slots_for(size_t capacity, double max_load) {
+      if (!(max_load > 0)) {
+        throw std::invalid_argument("robin_hood_dict max_load must be positive");
+      }
+      return size_t(std::max(1.0, std::ceil(capacity / max_load)));
+    }
+
+    // The slot key's probe run starts from. The hash is mixed first, as in
+    // lp_dict.
+    size_t home_of(uint32_t key) const noexcept {
+      return mix_bits(hashfxn.hash(key)) % size_;
+    }
+
+    // Index of the slot holding key, or size_ if key is absent.
+    size_t find_index(uint32_t key) const noexcept {
+      return find_index(key, home_of(key));
+    }
+
+    // As above, given key's home slot.
+    size_t find_index(uint32_t key, size_t index) const noexcept {
+      for (int distance = 0; slots_[index].distance >= distance; ++distance) {
+        if (slots_[index].item.key() == key) {
+          return index;
+        }
+        index = (index + 1) % size_;
+      }
+      return size_;                       // passed an entry nearer home than key would be
+    }
   };
   
 
@@ -306,34 +1341,73 @@ namespace hashes {
       c = 5;                         // set constant to 5 
     }
 
-    virtual T& search(uint32_t key) {
-      unsigned int index1 = hashfxn.at(0).hash(key) % size;       // generate two indexes using tabular hash function
-      unsigned int index2 = hashfxn.at(1).hash(key) % size;
+    // Create a dictionary holding the n given pairs, with capacity n per
+    // table. Entries are counting-sorted by their first-table slot and
+    // placed in that order directly into whichever of their two slots is
+    // free; only entries whose slots are both taken go through set() and
+    // its evictions. If unique_keys is true the caller guarantees that no
+    // key repeats; otherwise a repeated key keeps its last value.
+    static std::unique_ptr<cuckoo_dict> build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                                   bool unique_keys = false) {
+      std::unique_ptr<cuckoo_dict> dict(new cuckoo_dict(std::max<size_t>(n, 1)));
+      std::vector<size_t> homes(n);
+      for (size_t i = 0; i < n; i++) {
+        homes[i] = dict->home_slot(pairs[i].first);
+      }
+      std::vector<uint32_t> order = sort_by_home(homes, dict->size);
+      if (!unique_keys) {
+        drop_repeated_keys(order, homes, pairs);
+      }
 
-      if (entries_.at(0)->at(index1) != nullptr) {            // index of first table not empty
-        if (entries_.at(0)->at(index1)->key() == key){               // check index of first table
-          return (entries_.at(0)->at(index1)->value());              // return value if found
-        }
-        else{
-          if (entries_.at(1)->at(index2) != nullptr) {
-            if (entries_.at(1)->at(index2)->key() == key) {          // check index of second table 
-              return entries_.at(1)->at(index2)->value();          // return value if found
-            }
-          }
+      std::vector<uint32_t> deferred;                             // both slots taken
+      for (uint32_t i : order) {
+        uint32_t key = pairs[i].first;
+        entry<T>*& first = dict->entries_.at(0)->at(homes[i]);
+        entry<T>*& second = dict->entries_.at(1)->at(dict->hashfxn.at(1).hash(key) % dict->size);
+        if (first != nullptr && second != nullptr) {
+          deferred.push_back(i);
+          continue;
         }
+        T value = pairs[i].second;
+        (first == nullptr ? first : second) = new entry<T>(key, std::move(value));
       }
-      else {                                                  // index of first table empty 
-        if (entries_.at(1)->at(index2) != nullptr) {
-            if (entries_.at(1)->at(index2)->key() == key) {        // check index of second table 
-              return entries_.at(1)->at(index2)->value();          // return value if found
-            }
-          }
+      for (uint32_t i : deferred) {
+        T value = pairs[i].second;
+        dict->set(pairs[i].first, std::move(value));
       }
+      return dict;
+    }
+
+    using abstract_dict<T>::find;
 
-      throw std::out_of_range("key absent in cuckoo_dict::search");     // throw exception if not found in either index 
+    virtual const T* find(uint32_t key) const noexcept {
+      unsigned int index1 = hashfxn.at(0).hash(key) % size;       // generate two indexes using tabular hash function
+      unsigned int index2 = hashfxn.at(1).hash(key) % size;
+
+      return find_at(key, index1, index2);                        // value if found in either index, else nullptr
     } 
 
-    virtual void set(uint32_t key, T&& val) {
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      unsigned int indexes[2][BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {                      // hash, prefetch both candidate slots
+          for (int table = 0; table < 2; table++) {
+            indexes[table][i] = hashfxn.at(table).hash(keys[first + i]) % size;
+            prefetch(entries_.at(table)->data() + indexes[table][i]);
+          }
+        }
+        for (size_t i = 0; i < count; i++) {                      // prefetch the entries they point to
+          prefetch((*entries_.at(0))[indexes[0][i]]);
+          prefetch((*entries_.at(1))[indexes[1][i]]);
+        }
+        for (size_t i = 0; i < count; i++) {                      // resolve
+          out[first + i] = const_cast<T*>(find_at(keys[first + i], indexes[0][i], indexes[1][i]));
+        }
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
       if (lc == c*log(size)){             // checks for infinite loop and rebuild hash tables
         std::vector<std::vector<entry<T>*>*> temp_entry = entries_;
 
@@ -392,7 +1466,43 @@ namespace hashes {
       entries_.at(t)->at(index) = temp1;        // place temp key into empty index
     }
 
+    virtual bool erase(uint32_t key) {
+      bool found = false;
+      for (int i = 0; i < 2; i++) {                               // key can only be at its index in either table
+        unsigned int index = hashfxn.at(i).hash(key) % size;
+        entry<T>*& slot = entries_.at(i)->at(index);
+        if (slot != nullptr && slot->key() == key) {
+          delete slot;                                            // remove in place; nothing needs to move
+          slot = nullptr;
+          found = true;
+        }
+      }
+      return found;
+    }
+
+  protected:
+    // Entries start out in the first table, so insert_batch groups by it.
+    virtual size_t home_slot(uint32_t key) const noexcept { return hashfxn.at(0).hash(key) % size; }
+    virtual size_t table_slots() const noexcept { return size; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(entry<T>*); }
+
   private:
+    // Value of key, which can only be at index1 of the first table or
+    // index2 of the second, or nullptr.
+    const T* find_at(uint32_t key, unsigned int index1, unsigned int index2) const {
+      if (entries_.at(0)->at(index1) != nullptr) {            // index of first table not empty
+        if (entries_.at(0)->at(index1)->key() == key){               // check index of first table
+          return &(entries_.at(0)->at(index1)->value());             // return value if found
+        }
+      }
+      if (entries_.at(1)->at(index2) != nullptr) {
+        if (entries_.at(1)->at(index2)->key() == key) {          // check index of second table 
+          return &entries_.at(1)->at(index2)->value();         // return value if found
+        }
+      }
+      return nullptr;
+    }
+
     int size;       // capacity of hash table                           
     int lc;         // loop counter
     int c;          // constant 
@@ -400,4 +1510,962 @@ namespace hashes {
     std::vector<std::vector<entry<T>*>*> entries_;    // vector of vector pointers to entry pointers 
     std::vector<tabular_hash_func> hashfxn;           // vector of hash functions
   };
+
+  // SwissTable-style hash table. Slots are split into groups of 16, and a
+  // separate array holds one control byte per slot: 7 bits of the key's
+  // hash when the slot is full, or EMPTY/DELETED. A probe loads the 16
+  // control bytes of a group and compares them against the tag in one SSE2
+  // instruction; full keys are only compared for slots whose tag matched.
+  // Groups are probed quadratically, and the table doubles when it would
+  // exceed a 7/8 load factor.
+  template <typename T>
+  class swiss_dict : public abstract_dict<T> {
+  public:
+
+    // Create an empty dictionary, with the given capacity.
+    swiss_dict(size_t capacity) {
+      reset(next_power_of_two(std::max<size_t>(GROUP_WIDTH, (capacity * 8 + 6) / 7)));
+    }
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      size_t index = find_index(key);
+      return (index != size_) ? &slots_[index].value() : nullptr;
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      uint32_t hashes[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {          // hash, prefetch first group's tags and slots
+          hashes[i] = hash_of(keys[first + i]);
+          size_t slot = group_of(hashes[i]) * GROUP_WIDTH;
+          prefetch(&ctrl_[slot]);
+          prefetch(&slots_[slot]);
+        }
+        for (size_t i = 0; i < count; i++) {          // resolve
+          size_t index = find_index(keys[first + i], hashes[i]);
+          out[first + i] = (index != size_) ? &slots_[index].value() : nullptr;
+        }
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      size_t index = find_index(key);
+      if (index != size_) {
+        slots_[index].set_value(std::move(val));
+        return;
+      }
+      if (growth_left_ == 0) {
+        // drop tombstones if they are most of the load, otherwise grow
+        rehash(count_ < size_ * 7 / 16 ? size_ : size_ * 2);
+      }
+      insert_new(entry<T>(key, std::move(val)));
+    }
+
+    virtual bool erase(uint32_t key) {
+      size_t index = find_index(key);
+      if (index == size_) {
+        return false;
+      }
+
+      // A group that still has an empty slot never had a probe sequence run
+      // through it, so the slot can go straight back to EMPTY.
+      size_t group = index / GROUP_WIDTH;
+      if (match(&ctrl_[group * GROUP_WIDTH], EMPTY) != 0) {
+        ctrl_[index] = EMPTY;
+        ++growth_left_;
+      } else {
+        ctrl_[index] = DELETED;
+      }
+      --count_;
+      return true;
+    }
+
+  protected:
+    virtual size_t home_slot(uint32_t key) const noexcept {
+      return group_of(hash_of(key)) * GROUP_WIDTH;
+    }
+    virtual size_t table_slots() const noexcept { return size_; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(entry<T>) + 1; }
+
+  private:
+    static constexpr size_t GROUP_WIDTH = 16;     // control bytes matched per instruction
+    static constexpr int8_t EMPTY = -128;         // 0b10000000
+    static constexpr int8_t DELETED = -2;         // 0b11111110; full slots are 0b0xxxxxxx
+
+    size_t size_;                             // number of slots, a power of two
+    size_t group_mask_;                       // number of groups - 1
+    size_t count_;                            // number of full slots
+    size_t growth_left_;                      // inserts into EMPTY slots before a rehash
+    std::vector<int8_t> ctrl_;                // control bytes, one per slot
+    std::vector<entry<T>> slots_;             // entries, parallel to ctrl_
+    poly5_hash_func hashfxn;                  // hash function
+
+    // Bitmask of the slots in the group starting at ctrl whose control byte
+    // equals value.
+    static uint32_t match(const int8_t* ctrl, int8_t value) noexcept {
+#if HASHES_HAVE_SSE2
+      __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+      uint32_t mask = 0;
+      for (size_t i = 0; i < GROUP_WIDTH; i++) {
+        mask |= uint32_t(ctrl[i] == value) << i;
+      }
+      return mask;
+#endif
+    }
+
+    // Bitmask of the slots in the group starting at ctrl that are EMPTY or
+    // DELETED, i.e. whose control byte has its top bit set.
+    static uint32_t match_free(const int8_t* ctrl) noexcept {
+#if HASHES_HAVE_SSE2
+      return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)));
+#else
+      uint32_t mask = 0;
+      for (size_t i = 0; i < GROUP_WIDTH; i++) {
+        mask |= uint32_t(ctrl[i] < 0) << i;
+      }
+      return mask;
+#endif
+    }
+
+    // The polynomial hash, mixed so that all of its bits are usable (see
+    // mix_bits). The low 7 bits are the tag, and the bits above them pick
+    // the first group, so keys in the same group rarely share a tag.
+    uint32_t hash_of(uint32_t key) const noexcept { return mix_bits(hashfxn.hash(key)); }
+    static int8_t tag_of(uint32_t hash) noexcept { return int8_t(hash & 0x7F); }
+    size_t group_of(uint32_t hash) const noexcept { return (hash >> 7) & group_mask_; }
+
+    // Index of the slot holding key, or size_ if key is absent.
+    size_t find_index(uint32_t key) const noexcept {
+      return find_index(key, hash_of(key));
+    }
+
+    // As above, given key's hash.
+    size_t find_index(uint32_t key, uint32_t hash) const noexcept {
+      int8_t tag = tag_of(hash);
+      size_t group = group_of(hash);
+      for (size_t attempt = 1; attempt <= group_mask_ + 1; ++attempt) {
+        const int8_t* ctrl = &ctrl_[group * GROUP_WIDTH];
+        for (uint32_t mask = match(ctrl, tag); mask != 0; mask &= mask - 1) {
+          size_t index = group * GROUP_WIDTH + lowest_bit(mask);
+          if (slots_[index].key() == key) {
+            return index;
+          }
+        }
+        if (match(ctrl, EMPTY) != 0) {          // key would have been placed here
+          return size_;
+        }
+        group = (group + attempt) & group_mask_;
+      }
+      return size_;
+    }
+
+    // Place item, whose key is known to be absent, in the first free slot of
+    // its probe sequence. There must be room for it.
+    void insert_new(entry<T>&& item) {
+      uint32_t hash = hash_of(item.key());
+      size_t group = group_of(hash);
+      for (size_t attempt = 1; ; ++attempt) {
+        uint32_t mask = match_free(&ctrl_[group * GROUP_WIDTH]);
+        if (mask != 0) {
+          size_t index = group * GROUP_WIDTH + lowest_bit(mask);
+          if (ctrl_[index] == EMPTY) {
+            --growth_left_;
+          }
+          ctrl_[index] = tag_of(hash);
+          slots_[index] = std::move(item);
+          ++count_;
+          return;
+        }
+        group = (group + attempt) & group_mask_;
+      }
+    }
+
+    // Empty the table and resize it to the given number of slots.
+    void reset(size_t slots) {
+      size_ = slots;
+      group_mask_ = slots / GROUP_WIDTH - 1;
+      count_ = 0;
+      growth_left_ = slots * 7 / 8;
+      ctrl_.assign(slots, EMPTY);
+      slots_.assign(slots, entry<T>());
+    }
+
+    // Move every entry into a fresh table with the given number of slots,
+    // which clears all tombstones.
+    void rehash(size_t slots) {
+      std::vector<int8_t> old_ctrl;
+      std::vector<entry<T>> old_slots;
+      old_ctrl.swap(ctrl_);
+      old_slots.swap(slots_);
+      reset(slots);
+      for (size_t i = 0; i < old_ctrl.size(); i++) {
+        if (old_ctrl[i] >= 0) {
+          insert_new(std::move(old_slots[i]));
+        }
+      }
+    }
+  };
+
+  // Key marking an empty slot of flat_lp_dict.
+  const uint32_t FLAT_EMPTY_KEY = 0xFFFFFFFF;
+
+  // Group probes for flat_lp_dict. Each returns a bitmask of the 16 keys
+  // starting at group (one 64-byte cache line) that equal key or
+  // FLAT_EMPTY_KEY.
+
+#if HASHES_HAVE_X86
+  HASHES_TARGET("avx2")
+  inline uint32_t match_key_or_empty_avx2(const uint32_t* group, uint32_t key) noexcept {
+    const __m256i wanted = _mm256_set1_epi32(int(key)),
+                  empty = _mm256_set1_epi32(int(FLAT_EMPTY_KEY));
+    __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group)),
+            high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group + 8));
+    low = _mm256_or_si256(_mm256_cmpeq_epi32(low, wanted), _mm256_cmpeq_epi32(low, empty));
+    high = _mm256_or_si256(_mm256_cmpeq_epi32(high, wanted), _mm256_cmpeq_epi32(high, empty));
+    return uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(low))) |
+           (uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(high))) << 8);
+  }
+
+  HASHES_TARGET("avx512f")
+  inline uint32_t match_key_or_empty_avx512(const uint32_t* group, uint32_t key) noexcept {
+    __m512i keys = _mm512_loadu_si512(group);
+    return uint32_t(_mm512_cmpeq_epi32_mask(keys, _mm512_set1_epi32(int(key))) |
+                    _mm512_cmpeq_epi32_mask(keys, _mm512_set1_epi32(int(FLAT_EMPTY_KEY))));
+  }
+#endif
+
+  // Hash table with linear probing over a flat array of keys. Keys live in
+  // a contiguous, cache-line aligned uint32_t array with the values in a
+  // parallel array, so a probe never follows a pointer. With AVX2 or AVX-512
+  // a lookup tests a whole cache line of 16 keys for the key or an empty slot
+  // in one step; otherwise it falls back to testing one slot at a time. The
+  // instruction set is picked at runtime.
+  //
+  // FLAT_EMPTY_KEY marks empty slots, so that key is kept outside the table.
+  // Erase shifts the rest of the run back instead of leaving tombstones.
+  template <typename T>
+  class flat_lp_dict : public abstract_dict<T> {
+  public:
+
+    // Create an empty dictionary, with the given capacity, that probes with
+    // the widest instruction set available up to level.
+    flat_lp_dict(size_t capacity, simd_level level = simd_level::avx512)
+    : size_((std::max<size_t>(capacity, 1) + GROUP_WIDTH - 1) / GROUP_WIDTH * GROUP_WIDTH),
+      count_(0),
+      key_storage_(size_ + GROUP_WIDTH, FLAT_EMPTY_KEY),
+      values_(size_),
+      has_empty_key_(false),
+      empty_key_value_() {
+      // align keys_ to a cache line within key_storage_
+      uintptr_t address = reinterpret_cast<uintptr_t>(key_storage_.data());
+      keys_ = key_storage_.data() + (-address % 64) / sizeof(uint32_t);
+      use_simd(level);
+    }
+
+    // keys_ points into key_storage_, so a member-wise copy would point into
+    // the original's storage. Moving keeps the storage's buffer, and with it
+    // the alignment, so moves are safe.
+    flat_lp_dict(const flat_lp_dict&) = delete;
+    flat_lp_dict& operator=(const flat_lp_dict&) = delete;
+    flat_lp_dict(flat_lp_dict&&) = default;
+    flat_lp_dict& operator=(flat_lp_dict&&) = default;
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      if (key == FLAT_EMPTY_KEY) {
+        return has_empty_key_ ? &empty_key_value_ : nullptr;
+      }
+      size_t index = find_slot(key);
+      return (index != size_ && keys_[index] == key) ? &values_[index] : nullptr;
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      size_t indexes[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {        // hash, prefetch home key and value
+          indexes[i] = home_of(keys[first + i]);
+          prefetch(keys_ + indexes[i]);
+          prefetch(&values_[indexes[i]]);
+        }
+        for (size_t i = 0; i < count; i++) {        // resolve
+          uint32_t key = keys[first + i];
+          if (key == FLAT_EMPTY_KEY) {
+            out[first + i] = has_empty_key_ ? &empty_key_value_ : nullptr;
+            continue;
+          }
+          size_t index = find_slot(key, indexes[i]);
+          out[first + i] = (index != size_ && keys_[index] == key) ? &values_[index] : nullptr;
+        }
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      if (key == FLAT_EMPTY_KEY) {
+        has_empty_key_ = true;
+        empty_key_value_ = std::move(val);
+        return;
+      }
+      size_t index = find_slot(key);
+      if (index == size_) {
+        throw std::length_error("flat_lp_dict is full");
+      }
+      if (keys_[index] != key) {                  // claim the empty slot that ended the run
+        keys_[index] = key;
+        ++count_;
+      }
+      values_[index] = std::move(val);
+    }
+
+    virtual bool erase(uint32_t key) {
+      if (key == FLAT_EMPTY_KEY) {
+        bool found = has_empty_key_;
+        has_empty_key_ = false;
+        return found;
+      }
+      size_t hole = find_slot(key);
+      if (hole == size_ || keys_[hole] != key) {
+        return false;
+      }
+
+      // Walk the rest of the run, moving back every entry whose home slot
+      // does not lie cyclically in (hole, index]. The hole is always empty,
+      // so the walk ends even in a full table.
+      keys_[hole] = FLAT_EMPTY_KEY;
+      for (size_t index = (hole + 1) % size_; keys_[index] != FLAT_EMPTY_KEY; index = (index + 1) % size_) {
+        size_t home = home_of(keys_[index]);
+        bool stays = (hole <= index) ? (hole < home && home <= index)
+                                     : (hole < home || home <= index);
+        if (!stays) {
+          keys_[hole] = keys_[index];
+          values_[hole] = std::move(values_[index]);
+          keys_[index] = FLAT_EMPTY_KEY;
+          hole = index;
+        }
+      }
+      --count_;
+      return true;
+    }
+
+    // Probe with the widest instruction set available up to level.
+    void use_simd(simd_level level) noexcept {
+      level_ = std::min(level, detect_simd());
+#if HASHES_HAVE_X86
+      match_ = (level_ == simd_level::avx512) ? match_key_or_empty_avx512
+                                              : match_key_or_empty_avx2;
+#endif
+    }
+
+    simd_level simd() const noexcept { return level_; }
+
+    // Number of slots, which is the capacity rounded up to whole groups.
+    size_t table_size() const noexcept { return size_; }
+
+  protected:
+    virtual size_t home_slot(uint32_t key) const noexcept { return home_of(key); }
+    virtual size_t table_slots() const noexcept { return size_; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(uint32_t) + sizeof(T); }
+
+  private:
+    static constexpr size_t GROUP_WIDTH = 16;   // keys per cache line
+
+    size_t size_;                               // number of slots, a multiple of GROUP_WIDTH
+    size_t count_;                              // number of occupied slots
+    std::vector<uint32_t> key_storage_;         // backing store for keys_, with room to align
+    uint32_t* keys_;                            // slot keys, FLAT_EMPTY_KEY if empty
+    std::vector<T> values_;                     // slot values, parallel to keys_
+    bool has_empty_key_;                        // whether FLAT_EMPTY_KEY itself is present
+    T empty_key_value_;                         // and its value
+    simd_level level_;                          // instruction set used by find_slot
+    uint32_t (*match_)(const uint32_t*, uint32_t) noexcept = nullptr;
+    poly5_hash_func hashfxn;                    // hash function
+
+    // The slot key's run starts from. The hash is mixed first, as in
+    // lp_dict.
+    size_t home_of(uint32_t key) const noexcept {
+      return mix_bits(hashfxn.hash(key)) % size_;
+    }
+
+    // Index of the slot holding key or, if key is absent, of the empty slot
+    // that ends its run. size_ if the table is full and key is absent.
+    size_t find_slot(uint32_t key) const noexcept {
+      return find_slot(key, home_of(key));
+    }
+
+    // As above, given key's home slot.
+    size_t find_slot(uint32_t key, size_t index) const noexcept {
+
+      if (level_ == simd_level::scalar) {
+        for (size_t counter = 0; counter < size_; ++counter) {
+          if (keys_[index] == key || keys_[index] == FLAT_EMPTY_KEY) {
+            return index;
+          }
+          index = (index + 1) % size_;
+        }
+        return size_;
+      }
+
+      // Probe group by group, ignoring the slots of the first group that
+      // come before index. The first group is visited again at the end, in
+      // case the run wrapped around the whole table.
+      size_t group = index - index % GROUP_WIDTH;
+      uint32_t lanes = ~uint32_t(0) << (index - group);
+      for (size_t counter = 0; counter <= size_ / GROUP_WIDTH; ++counter) {
+        uint32_t mask = match_(keys_ + group, key) & lanes;
+        if (mask != 0) {
+          return group + lowest_bit(mask);
+        }
+        lanes = ~uint32_t(0);
+        group = (group + GROUP_WIDTH) % size_;
+      }
+      return size_;
+    }
+  };
+
+  // Return the index of key among the first count keys, or count if it is
+  // absent. Only those count keys are read.
+  inline size_t find_key_scalar(const uint32_t* keys, size_t count, uint32_t key) noexcept {
+    for (size_t i = 0; i < count; i++) {
+      if (keys[i] == key) {
+        return i;
+      }
+    }
+    return count;
+  }
+
+#if HASHES_HAVE_SSE2
+  // As find_key_scalar, comparing 4 keys per step. SSE2 is part of the
+  // baseline instruction set, so unlike the AVX2 kernel this inlines into
+  // any caller. The array must be readable up to count rounded up to 4.
+  inline size_t find_key_sse2(const uint32_t* keys, size_t count, uint32_t key) noexcept {
+    const __m128i wanted = _mm_set1_epi32(int(key));
+    for (size_t i = 0; i < count; i += 4) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      uint32_t mask = uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, wanted))));
+      if (mask != 0) {
+        size_t index = i + lowest_bit(mask);
+        return (index < count) ? index : count;
+      }
+    }
+    return count;
+  }
+#endif
+
+#if HASHES_HAVE_X86
+  // As find_key_scalar, comparing 8 keys per step. The array must be
+  // readable up to count rounded up to 8.
+  HASHES_TARGET("avx2")
+  inline size_t find_key_avx2(const uint32_t* keys, size_t count, uint32_t key) noexcept {
+    const __m256i wanted = _mm256_set1_epi32(int(key));
+    for (size_t i = 0; i < count; i += 8) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+      uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, wanted))));
+      if (mask != 0) {
+        size_t index = i + lowest_bit(mask);
+        return (index < count) ? index : count;
+      }
+    }
+    return count;
+  }
+
+  // Set indexes[i] to find_key_avx2(keys, count, queries[i]) for each of the
+  // n queries, so a batch pays for one call into AVX2 code, not one each.
+  HASHES_TARGET("avx2")
+  inline void find_keys_avx2(const uint32_t* keys, size_t count, const uint32_t* queries,
+                             size_t* indexes, size_t n) noexcept {
+    for (size_t i = 0; i < n; i++) {
+      indexes[i] = find_key_avx2(keys, count, queries[i]);
+    }
+  }
+#endif
+
+  // Dictionary for maps that are usually tiny. Up to SMALL_CAPACITY keys
+  // live inline, in a contiguous uint32_t array with the values in a
+  // parallel array, so a small map allocates nothing beyond itself and a
+  // lookup needs no hashing. A lookup compares 4 keys per SSE2 instruction
+  // (or one at a time without SSE2) in a loop inlined into the caller;
+  // search_batch hands the whole batch to an AVX2 kernel that compares 8
+  // at a time, where the CPU has it. Adding a key past SMALL_CAPACITY moves
+  // every entry into a Large hash table, which then serves all operations;
+  // the map does not move back if it shrinks again.
+  template <typename T, typename Large = swiss_dict<T>>
+  class small_map_dict : public abstract_dict<T> {
+  public:
+
+    static constexpr size_t SMALL_CAPACITY = 32;
+
+    // Create an empty dictionary. The capacity only sizes the hash table,
+    // if the map ever grows into one.
+    small_map_dict(size_t capacity, simd_level level = simd_level::avx2)
+    : capacity_(capacity) {
+      use_simd(level);
+    }
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      if (large_) {
+        return large_->find(key);
+      }
+      size_t index = find_slot(key);
+      return (index != count_) ? &values_[index] : nullptr;
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      if (large_) {
+        large_->search_batch(keys, out, n);
+        return;
+      }
+#if HASHES_HAVE_X86
+      if (level_ == simd_level::avx2) {
+        size_t indexes[BATCH_GROUP];
+        for (size_t first = 0; first < n; first += BATCH_GROUP) {
+          size_t count = std::min(BATCH_GROUP, n - first);
+          find_keys_avx2(keys_, count_, keys + first, indexes, count);
+          for (size_t i = 0; i < count; i++) {
+            out[first + i] = (indexes[i] != count_) ? &values_[indexes[i]] : nullptr;
+          }
+        }
+        return;
+      }
+#endif
+      for (size_t i = 0; i < n; i++) {              // already in cache: nothing to prefetch
+        size_t index = find_slot(keys[i]);
+        out[i] = (index != count_) ? &values_[index] : nullptr;
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      if (large_) {
+        large_->set(key, std::move(val));
+        return;
+      }
+      size_t index = find_slot(key);
+      if (index != count_) {
+        values_[index] = std::move(val);
+      } else if (count_ < SMALL_CAPACITY) {
+        keys_[count_] = key;
+        values_[count_++] = std::move(val);
+      } else {
+        promote();
+        large_->set(key, std::move(val));
+      }
+    }
+
+    virtual bool erase(uint32_t key) {
+      if (large_) {
+        return large_->erase(key);
+      }
+      size_t index = find_slot(key);
+      if (index == count_) {
+        return false;
+      }
+      count_--;
+      keys_[index] = keys_[count_];                 // order is irrelevant, so fill the hole from the back
+      values_[index] = std::move(values_[count_]);
+      return true;
+    }
+
+    // Scan batches with the widest instruction set available up to level.
+    void use_simd(simd_level level) noexcept {
+      level_ = std::min(level, std::min(simd_level::avx2, detect_simd()));
+    }
+
+    simd_level simd() const noexcept { return level_; }
+
+    // Whether the entries have moved to the hash table.
+    bool promoted() const noexcept { return large_ != nullptr; }
+
+  protected:
+    virtual size_t table_slots() const noexcept { return 1; }
+    virtual size_t slot_bytes() const noexcept { return sizeof(uint32_t) + sizeof(T); }
+
+  private:
+    uint32_t keys_[SMALL_CAPACITY] = {};               // only the first count_ are in use
+    T values_[SMALL_CAPACITY];
+    size_t count_ = 0;
+    size_t capacity_;                                  // capacity for the hash table
+    std::unique_ptr<Large> large_;                     // the hash table, once promoted
+    simd_level level_;
+
+    // Index of key among the first count_ keys, or count_ if it is absent.
+    size_t find_slot(uint32_t key) const noexcept {
+#if HASHES_HAVE_SSE2
+      return find_key_sse2(keys_, count_, key);
+#else
+      return find_key_scalar(keys_, count_, key);
+#endif
+    }
+
+    // Move every entry into a new hash table.
+    void promote() {
+      large_.reset(new Large(std::max(capacity_, 2 * SMALL_CAPACITY)));
+      for (size_t i = 0; i < count_; i++) {
+        large_->set(keys_[i], std::move(values_[i]));
+      }
+      count_ = 0;
+    }
+  };
+
+  // Position of the first of the n sorted keys that is not less than key,
+  // or n if there is none. The loop always runs log2(n) times and its only
+  // data-dependent step is a conditional move, so it never mispredicts.
+  inline size_t branchless_lower_bound(const uint32_t* keys, size_t n, uint32_t key) noexcept {
+    if (n == 0) {
+      return 0;
+    }
+    const uint32_t* base = keys;
+    while (n > 1) {
+      size_t half = n / 2;
+      base = (base[half] < key) ? base + half : base;
+      n -= half;
+    }
+    return (base - keys) + (*base < key);
+  }
+
+  // Search layouts for sorted_dict. A layout indexes a sorted array of keys
+  // and finds the position of a key in it; rank() returns that position,
+  // or NOT_FOUND if the key is absent. build() is called again whenever the
+  // array changes.
+  const size_t NOT_FOUND = ~size_t(0);
+
+  // Branchless binary search directly on the sorted array.
+  class binary_search_layout {
+  public:
+
+    void build(const std::vector<uint32_t>& keys) {
+      keys_ = keys.data();
+      n_ = keys.size();
+    }
+
+    size_t rank(uint32_t key) const noexcept {
+      size_t index = branchless_lower_bound(keys_, n_, key);
+      return (index < n_ && keys_[index] == key) ? index : NOT_FOUND;
+    }
+
+    // Search for all n keys, a group at a time, advancing every search of
+    // the group one level per pass and prefetching both halves each search
+    // may go to next, so the group's cache misses overlap.
+    void rank_batch(const uint32_t* keys, size_t* ranks, size_t n) const noexcept {
+      const uint32_t* bases[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {
+          bases[i] = keys_;
+        }
+        for (size_t length = n_; length > 1; ) {
+          size_t half = length / 2, quarter = (length - half) / 2;
+          for (size_t i = 0; i < count; i++) {
+            prefetch(bases[i] + quarter);
+            prefetch(bases[i] + half + quarter);
+          }
+          for (size_t i = 0; i < count; i++) {
+            bases[i] = (bases[i][half] < keys[first + i]) ? bases[i] + half : bases[i];
+          }
+          length -= half;
+        }
+        for (size_t i = 0; i < count; i++) {
+          size_t index = (n_ == 0) ? 0 : (bases[i] - keys_) + (*bases[i] < keys[first + i]);
+          ranks[first + i] = (index < n_ && keys_[index] == keys[first + i]) ? index : NOT_FOUND;
+        }
+      }
+    }
+
+  private:
+    const uint32_t* keys_ = nullptr;
+    size_t n_ = 0;
+  };
+
+  // Eytzinger (BFS) layout: the keys as an implicit complete binary search
+  // tree, with node k's children at 2k and 2k+1 (k starting at 1). Each
+  // node also holds its key's position in the sorted array, so a hit costs
+  // no extra miss. The top levels of the tree share a few cache lines, and
+  // the 16 descendants of node k four levels down sit together at 16k, so
+  // each step prefetches the lines it will need four steps later.
+  class eytzinger_layout {
+  public:
+
+    void build(const std::vector<uint32_t>& keys) {
+      tree_.assign(keys.size() + 1, node{0, 0});
+      size_t next = 0;
+      fill(keys, 1, next);
+    }
+
+    size_t rank(uint32_t key) const noexcept {
+      size_t n = tree_.size() - 1, k = 1;
+      while (k <= n) {
+        prefetch(tree_.data() + std::min(16 * k, n));        // the 16 nodes four levels down
+        prefetch(tree_.data() + std::min(16 * k + 8, n));
+        k = 2 * k + (tree_[k].key < key);
+      }
+      return resolve(k, key);
+    }
+
+    // Search for all n keys, a group at a time, advancing every search of
+    // the group one level per pass.
+    void rank_batch(const uint32_t* keys, size_t* ranks, size_t n) const noexcept {
+      size_t nodes = tree_.size() - 1;
+      size_t ks[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        for (size_t i = 0; i < count; i++) {
+          ks[i] = 1;
+        }
+        for (size_t level = 1; level <= nodes; level *= 2) {   // one pass per tree level
+          for (size_t i = 0; i < count; i++) {
+            if (ks[i] <= nodes) {
+              prefetch(tree_.data() + std::min(16 * ks[i], nodes));
+              prefetch(tree_.data() + std::min(16 * ks[i] + 8, nodes));
+              ks[i] = 2 * ks[i] + (tree_[ks[i]].key < keys[first + i]);
+            }
+          }
+        }
+        for (size_t i = 0; i < count; i++) {
+          ranks[first + i] = resolve(ks[i], keys[first + i]);
+        }
+      }
+    }
+
+  private:
+    struct node {
+      uint32_t key;
+      uint32_t rank;                              // position of key in the sorted array
+    };
+
+    std::vector<node> tree_;                      // nodes in BFS order, tree_[0] unused
+
+    // Fill the subtree rooted at node k by an in-order walk of the sorted keys.
+    void fill(const std::vector<uint32_t>& keys, size_t k, size_t& next) {
+      if (k < tree_.size()) {
+        fill(keys, 2 * k, next);
+        tree_[k] = node{keys[next], uint32_t(next)};
+        next++;
+        fill(keys, 2 * k + 1, next);
+      }
+    }
+
+    // The search ended below the tree at k. The last node where it went
+    // left holds the smallest key not less than key; drop the right turns
+    // made after it, then that left turn, to get back to that node.
+    size_t resolve(size_t k, uint32_t key) const noexcept {
+      uint64_t turns = ~uint64_t(k);                 // right turns are now the trailing 0s
+      unsigned drop = (uint32_t(turns) != 0) ? lowest_bit(uint32_t(turns))
+                                             : 32 + lowest_bit(uint32_t(turns >> 32));
+      k >>= drop + 1;
+      return (k != 0 && tree_[k].key == key) ? tree_[k].rank : NOT_FOUND;
+    }
+  };
+
+  // Ordered dictionary over a sorted array of keys and a parallel array of
+  // values, searched through a Layout (binary_search_layout by default, or
+  // eytzinger_layout). Unlike the hash tables it can visit keys in order,
+  // through scan().
+  //
+  // Inserting into the middle of a sorted array moves half of it, so new
+  // keys first go to a small sorted overflow array, which is merged into
+  // the main one (rebuilding the layout) once it outgrows a bound of about
+  // the square root of the main one's size. Erased keys of the main array
+  // are only marked dead until the next merge; setting one again revives
+  // it in place. Each key is in exactly one of the two arrays, and lookups
+  // search the main array through the layout and then the overflow array.
+  template <typename T, typename Layout = binary_search_layout>
+  class sorted_dict : public abstract_dict<T> {
+  public:
+
+    // Create an empty dictionary. Its arrays grow as needed, so the
+    // capacity only reserves room.
+    sorted_dict(size_t capacity) {
+      keys_.reserve(capacity);
+      values_.reserve(capacity);
+      layout_.build(keys_);
+    }
+
+    // binary_search_layout points into keys_, so a member-wise copy would
+    // search the original's keys. Moving keeps keys_'s buffer, so moves
+    // are safe.
+    sorted_dict(const sorted_dict&) = delete;
+    sorted_dict& operator=(const sorted_dict&) = delete;
+    sorted_dict(sorted_dict&&) = default;
+    sorted_dict& operator=(sorted_dict&&) = default;
+
+    // Create a dictionary holding the n given pairs, sorted once. If
+    // unique_keys is true the caller guarantees that no key repeats;
+    // otherwise a repeated key keeps its last value.
+    static std::unique_ptr<sorted_dict> build_from(const std::pair<uint32_t, T>* pairs, size_t n,
+                                                   bool unique_keys = false) {
+      std::unique_ptr<sorted_dict> dict(new sorted_dict(n));
+      std::vector<uint32_t> order(n);
+      for (size_t i = 0; i < n; i++) {
+        order[i] = uint32_t(i);
+      }
+      std::stable_sort(order.begin(), order.end(),
+                       [&](uint32_t a, uint32_t b) { return pairs[a].first < pairs[b].first; });
+      for (size_t i = 0; i < n; i++) {
+        if (!unique_keys && i + 1 < n && pairs[order[i + 1]].first == pairs[order[i]].first) {
+          continue;                                  // a later value for this key follows
+        }
+        dict->keys_.push_back(pairs[order[i]].first);
+        dict->values_.push_back(pairs[order[i]].second);
+      }
+      dict->live_.assign(dict->keys_.size(), 1);
+      dict->layout_.build(dict->keys_);
+      return dict;
+    }
+
+    using abstract_dict<T>::find;
+
+    virtual const T* find(uint32_t key) const noexcept {
+      size_t index = layout_.rank(key);
+      if (index != NOT_FOUND) {
+        return live_[index] ? &values_[index] : nullptr;
+      }
+      return find_overflow(key);
+    }
+
+    virtual void search_batch(const uint32_t* keys, T** out, size_t n) {
+      size_t ranks[BATCH_GROUP];
+      for (size_t first = 0; first < n; first += BATCH_GROUP) {
+        size_t count = std::min(BATCH_GROUP, n - first);
+        layout_.rank_batch(keys + first, ranks, count);
+        for (size_t i = 0; i < count; i++) {
+          size_t index = ranks[i];
+          if (index != NOT_FOUND) {
+            out[first + i] = live_[index] ? &values_[index] : nullptr;
+          } else {
+            out[first + i] = const_cast<T*>(find_overflow(keys[first + i]));
+          }
+        }
+      }
+    }
+
+    virtual void set(uint32_t key, T&& val) {
+      size_t index = layout_.rank(key);
+      if (index != NOT_FOUND) {
+        values_[index] = std::move(val);
+        if (!live_[index]) {
+          live_[index] = 1;
+          dead_--;
+        }
+        return;
+      }
+      size_t slot = branchless_lower_bound(overflow_keys_.data(), overflow_keys_.size(), key);
+      if (slot < overflow_keys_.size() && overflow_keys_[slot] == key) {
+        overflow_values_[slot] = std::move(val);
+        return;
+      }
+      overflow_keys_.insert(overflow_keys_.begin() + slot, key);
+      overflow_values_.insert(overflow_values_.begin() + slot, std::move(val));
+      if (overflow_keys_.size() > overflow_limit()) {
+        merge();
+      }
+    }
+
+    virtual bool erase(uint32_t key) {
+      size_t index = layout_.rank(key);
+      if (index != NOT_FOUND) {
+        if (!live_[index]) {
+          return false;
+        }
+        live_[index] = 0;
+        if (++dead_ > keys_.size() / 2) {
+          merge();                                  // mostly dead: compact
+        }
+        return true;
+      }
+      size_t slot = branchless_lower_bound(overflow_keys_.data(), overflow_keys_.size(), key);
+      if (slot == overflow_keys_.size() || overflow_keys_[slot] != key) {
+        return false;
+      }
+      overflow_keys_.erase(overflow_keys_.begin() + slot);
+      overflow_values_.erase(overflow_values_.begin() + slot);
+      return true;
+    }
+
+    // Call visit(key, value) for every key from low to high inclusive, in
+    // increasing key order. Return the number of keys visited.
+    template <typename Visit>
+    size_t scan(uint32_t low, uint32_t high, Visit visit) const {
+      size_t i = branchless_lower_bound(keys_.data(), keys_.size(), low),
+             j = branchless_lower_bound(overflow_keys_.data(), overflow_keys_.size(), low),
+             visited = 0;
+      for (;;) {
+        while (i < keys_.size() && !live_[i]) {
+          i++;
+        }
+        bool main_left = (i < keys_.size() && keys_[i] <= high),
+             overflow_left = (j < overflow_keys_.size() && overflow_keys_[j] <= high);
+        if (!main_left && !overflow_left) {
+          return visited;
+        }
+        if (main_left && (!overflow_left || keys_[i] < overflow_keys_[j])) {
+          visit(keys_[i], values_[i]);
+          i++;
+        } else {
+          visit(overflow_keys_[j], overflow_values_[j]);
+          j++;
+        }
+        visited++;
+      }
+    }
+
+    // Number of keys present.
+    size_t size() const noexcept {
+      return keys_.size() - dead_ + overflow_keys_.size();
+    }
+
+  private:
+    std::vector<uint32_t> keys_;                  // main array, sorted
+    std::vector<T> values_;                       // parallel to keys_
+    std::vector<uint8_t> live_;                   // 0 where the key of keys_ was erased
+    size_t dead_ = 0;                             // number of 0s in live_
+    std::vector<uint32_t> overflow_keys_;         // keys set since the last merge, sorted
+    std::vector<T> overflow_values_;              // parallel to overflow_keys_
+    Layout layout_;                               // search structure over keys_
+
+    // Most keys the overflow array may hold before a merge. A merge moves
+    // every key, and an insert into the overflow array moves half of it,
+    // so a bound near the square root of the size balances the two.
+    size_t overflow_limit() const noexcept {
+      return std::max<size_t>(64, size_t(8 * std::sqrt(double(keys_.size()))));
+    }
+
+    const T* find_overflow(uint32_t key) const noexcept {
+      size_t slot = branchless_lower_bound(overflow_keys_.data(), overflow_keys_.size(), key);
+      return (slot < overflow_keys_.size() && overflow_keys_[slot] == key) ? &overflow_values_[slot] : nullptr;
+    }
+
+    // Merge the live keys of the main array with the overflow array into a
+    // new main array, and rebuild the layout over it.
+    void merge() {
+      std::vector<uint32_t> keys;
+      std::vector<T> values;
+      keys.reserve(size());
+      values.reserve(size());
+      size_t i = 0, j = 0;
+      while (i < keys_.size() || j < overflow_keys_.size()) {
+        if (i < keys_.size() && !live_[i]) {
+          i++;
+        } else if (j == overflow_keys_.size() || (i < keys_.size() && keys_[i] < overflow_keys_[j])) {
+          keys.push_back(keys_[i]);
+          values.push_back(std::move(values_[i++]));
+        } else {
+          keys.push_back(overflow_keys_[j]);
+          values.push_back(std::move(overflow_values_[j++]));
+        }
+      }
+      keys_.swap(keys);
+      values_.swap(values);
+      live_.assign(keys_.size(), 1);
+      dead_ = 0;
+      overflow_keys_.clear();
+      overflow_values_.clear();
+      layout_.build(keys_);
+    }
+  };
 }
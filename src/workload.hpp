@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+// workload.hpp
+//
+// Benchmark workloads: key sets in random, sequential, strided or
+// hash-adversarial order, record choosers with uniform, Zipfian, hotspot
+// or latest-first skew, and the YCSB core operation mixes A to F.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace hashes {
+
+  // Order of the distinct keys a benchmark inserts and searches for.
+  enum class key_order {
+    uniform,          // a random permutation of [0, total)
+    sequential,       // 0, 1, 2, ..., like auto-increment IDs
+    strided,          // 0, s, 2s, ..., sharing their low bits
+    adversarial       // keys whose home slots in one given table all lie
+                      // close together (see make_colliding_keys)
+  };
+
+  // Adversarial keys home into the first 1 / ADVERSARIAL_SPREAD of the
+  // table's slots.
+  const size_t ADVERSARIAL_SPREAD = 64;
+
+  // Return total distinct keys in the given order, other than adversarial.
+  // stride is the spacing of strided keys; once multiples of stride run
+  // past 2^32, the next round of multiples is offset by 1, then 2, and so
+  // on, so keys stay distinct and keep their residues close together.
+  // Throw std::invalid_argument for adversarial keys, which depend on the
+  // table; make_colliding_keys makes those.
+  inline std::vector<uint32_t> make_keys(key_order order, size_t total, uint64_t stride,
+                                         std::mt19937& gen) {
+    if (order == key_order::adversarial) {
+      throw std::invalid_argument("make_keys cannot make adversarial keys");
+    }
+    std::vector<uint32_t> keys(total);
+    if (order == key_order::uniform || order == key_order::sequential || stride <= 1) {
+      for (size_t i = 0; i < total; i++) {
+        keys[i] = uint32_t(i);
+      }
+      if (order == key_order::uniform) {
+        std::shuffle(keys.begin(), keys.end(), gen);
+      }
+      return keys;
+    }
+    const uint64_t period = (uint64_t(1) << 32) / stride;     // multiples per round
+    if (uint64_t(total) > period * stride) {
+      throw std::length_error("too many keys for the stride in make_keys");
+    }
+    for (size_t i = 0; i < total; i++) {
+      keys[i] = uint32_t((i % period) * stride + i / period);
+    }
+    return keys;
+  }
+
+  // Return total distinct keys, in random order, that collide in a table of
+  // the given number of slots, where home(key) is the slot key's search
+  // starts from: only keys homed in the first slots / ADVERSARIAL_SPREAD
+  // slots are kept. The hash is what decides which keys those are, so they
+  // are found by trying 0, 1, 2, ... in turn, about ADVERSARIAL_SPREAD
+  // candidates per key. Throw std::length_error if the 2^32 candidates run
+  // out first.
+  template <typename Home>
+  std::vector<uint32_t> make_colliding_keys(size_t total, size_t slots, Home home,
+                                            std::mt19937& gen) {
+    const size_t range = std::max<size_t>(1, slots / ADVERSARIAL_SPREAD);
+    std::vector<uint32_t> keys;
+    keys.reserve(total);
+    for (uint64_t key = 0; keys.size() < total; key++) {
+      if (key > 0xFFFFFFFFu) {
+        throw std::length_error("too few colliding keys in make_colliding_keys");
+      }
+      if (home(uint32_t(key)) < range) {
+        keys.push_back(uint32_t(key));
+      }
+    }
+    std::shuffle(keys.begin(), keys.end(), gen);
+    return keys;
+  }
+
+  // Zipfian distribution over [0, count), where item i is chosen with
+  // probability proportional to 1 / (i + 1)^theta, by the method of Gray
+  // et al., "Quickly generating billion-record synthetic databases" (as in
+  // YCSB). theta must be in [0, 1); 0 is uniform, and YCSB uses 0.99. The
+  // count can grow as records are inserted, at the cost of one term per
+  // new item.
+  class zipf_distribution {
+  public:
+
+    zipf_distribution(size_t count, double theta)
+    : theta_(theta), count_(0), zeta_n_(0) {
+      if (!(theta >= 0 && theta < 1)) {
+        throw std::invalid_argument("zipf_distribution theta must be in [0, 1)");
+      }
+      alpha_ = 1 / (1 - theta_);
+      zeta_2_ = 1 + std::pow(0.5, theta_);
+      grow(std::max<size_t>(count, 1));
+    }
+
+    // Extend the distribution to [0, count).
+    void grow(size_t count) {
+      for (; count_ < count; count_++) {
+        zeta_n_ += 1 / std::pow(double(count_ + 1), theta_);
+      }
+      eta_ = (1 - std::pow(2.0 / count_, 1 - theta_)) / (1 - zeta_2_ / zeta_n_);
+    }
+
+    size_t operator()(std::mt19937& gen) {
+      double u = std::uniform_real_distribution<double>(0, 1)(gen),
+             uz = u * zeta_n_;
+      if (uz < 1) {
+        return 0;
+      }
+      if (uz < zeta_2_) {
+        return std::min<size_t>(1, count_ - 1);
+      }
+      size_t item = size_t(count_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+      return std::min(item, count_ - 1);
+    }
+
+  private:
+    double theta_, alpha_, eta_, zeta_2_;
+    size_t count_;
+    double zeta_n_;                     // sum of 1 / i^theta for i = 1 .. count_
+  };
+
+  // How operations pick which existing record to touch.
+  enum class access_pattern {
+    uniform,          // every record equally likely
+    zipf,             // record i with weight 1 / (i + 1)^theta
+    hotspot,          // a fraction h of the records get 1 - h of the operations
+    latest            // Zipfian by age, newest record first
+  };
+
+  // Chooses record indexes in [0, count) by an access pattern. Records are
+  // indexed in insertion order, so zipf favours the oldest and latest the
+  // newest; when the records are a random permutation the favoured keys
+  // are scattered through the table.
+  class record_chooser {
+  public:
+
+    // parameter is theta for zipf and latest, and the hot fraction h for
+    // hotspot.
+    record_chooser(access_pattern pattern, double parameter, size_t count)
+    : pattern_(pattern), parameter_(parameter), count_(std::max<size_t>(count, 1)),
+      zipf_(count_, (pattern == access_pattern::zipf || pattern == access_pattern::latest) ? parameter : 0) {
+      if (pattern == access_pattern::hotspot && !(parameter > 0 && parameter < 1)) {
+        throw std::invalid_argument("record_chooser hot fraction must be in (0, 1)");
+      }
+    }
+
+    // Records were appended, and there are now count of them.
+    void grow(size_t count) {
+      count_ = std::max(count_, count);
+      if (pattern_ == access_pattern::zipf || pattern_ == access_pattern::latest) {
+        zipf_.grow(count_);
+      }
+    }
+
+    size_t operator()(std::mt19937& gen) {
+      switch (pattern_) {
+      case access_pattern::zipf:
+        return zipf_(gen);
+      case access_pattern::latest:
+        return count_ - 1 - zipf_(gen);
+      case access_pattern::hotspot: {
+        size_t hot = std::max<size_t>(1, size_t(count_ * parameter_));
+        if (std::uniform_real_distribution<double>(0, 1)(gen) < 1 - parameter_ || hot == count_) {
+          return std::uniform_int_distribution<size_t>(0, hot - 1)(gen);
+        }
+        return std::uniform_int_distribution<size_t>(hot, count_ - 1)(gen);
+      }
+      default:
+        return std::uniform_int_distribution<size_t>(0, count_ - 1)(gen);
+      }
+    }
+
+  private:
+    access_pattern pattern_;
+    double parameter_;
+    size_t count_;
+    zipf_distribution zipf_;
+  };
+
+  // The kinds of YCSB operation.
+  enum class ycsb_operation { read, update, insert, scan, read_modify_write };
+
+  // Operation mix of a YCSB core workload: the fraction of each kind of
+  // operation, and the default access pattern for choosing records.
+  struct ycsb_mix {
+    char name;
+    double read, update, insert, scan, read_modify_write;
+    access_pattern pattern;
+    double parameter;                   // for pattern, as in record_chooser
+
+    // Draw the kind of the next operation.
+    ycsb_operation choose(std::mt19937& gen) const {
+      double u = std::uniform_real_distribution<double>(0, 1)(gen);
+      if ((u -= read) < 0) {
+        return ycsb_operation::read;
+      }
+      if ((u -= update) < 0) {
+        return ycsb_operation::update;
+      }
+      if ((u -= insert) < 0) {
+        return ycsb_operation::insert;
+      }
+      if ((u -= scan) < 0) {
+        return ycsb_operation::scan;
+      }
+      return ycsb_operation::read_modify_write;
+    }
+  };
+
+  // Longest scan in YCSB workload E; scan lengths are uniform in [1, this].
+  const size_t YCSB_MAX_SCAN = 100;
+
+  // Load factor a YCSB table reaches once all of a workload's inserts are
+  // in, unless the benchmark is given another.
+  const double YCSB_LOAD = 0.7;
+
+  // The YCSB core workload named A to F:
+  //   A  update heavy: 50% read, 50% update, Zipfian
+  //   B  read mostly: 95% read, 5% update, Zipfian
+  //   C  read only: 100% read, Zipfian
+  //   D  read latest: 95% read, 5% insert, newest records most popular
+  //   E  short ranges: 95% scan, 5% insert, Zipfian
+  //   F  read-modify-write: 50% read, 50% read-modify-write, Zipfian
+  // Throw std::invalid_argument for any other name.
+  inline ycsb_mix ycsb_workload(char name) {
+    const double theta = 0.99;
+    switch (name) {
+    case 'A': case 'a': return {'A', 0.5, 0.5, 0, 0, 0, access_pattern::zipf, theta};
+    case 'B': case 'b': return {'B', 0.95, 0.05, 0, 0, 0, access_pattern::zipf, theta};
+    case 'C': case 'c': return {'C', 1, 0, 0, 0, 0, access_pattern::zipf, theta};
+    case 'D': case 'd': return {'D', 0.95, 0, 0.05, 0, 0, access_pattern::latest, theta};
+    case 'E': case 'e': return {'E', 0, 0, 0.05, 0.95, 0, access_pattern::zipf, theta};
+    case 'F': case 'f': return {'F', 0.5, 0, 0, 0, 0.5, access_pattern::zipf, theta};
+    default:
+      throw std::invalid_argument("ycsb_workload name must be one of A to F");
+    }
+  }
+
+}